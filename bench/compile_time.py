@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+"""Measures how compile time and compiler peak RSS grow with pattern size.
+
+Every pattern of every family is compiled once per stage, and each stage
+instantiates a bit more of the pipeline than the one before it:
+
+    parse     ParseRegex only
+    subset    NFAToDFA, the Thompson NFA and the subset construction
+    minimize  MinimizeDFA of that DFA
+    full      Regex::match and Regex::search, i.e. what a user pays for
+
+The cost of a stage is roughly its row minus the row of the stage before it.
+The counting stage stands apart: it is the full stage with CountingEngine,
+which builds no DFA, so its row should not grow with the bounds of repeats.
+The "include" row is a translation unit that includes the headers and nothing
+else. Results are written as CSV, one row per (family, n, stage).
+
+    bench/compile_time.py -o compile_time.csv
+    bench/compile_time.py --family repeat --sizes 16,32,64 --compare old.csv
+    bench/compile_time.py --family repeat --stage counting --sizes 64,1024,16384
+
+With --compare, the run exits with status 1 if some compile that succeeded
+in the old report got slower by more than --tolerance times, or stopped
+succeeding.
+"""
+
+import argparse
+import csv
+import os
+import shlex
+import signal
+import string
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+STAGES = ["parse", "subset", "minimize", "full", "counting"]
+
+
+def literal(n):
+    letters = string.ascii_lowercase
+    return "".join(letters[i % len(letters)] for i in range(n))
+
+
+def alternation(n):
+    # n distinct three letter words, so no two alternatives collapse.
+    letters = string.ascii_lowercase
+    words = []
+    for i in range(n):
+        words.append(letters[i // 676 % 26] + letters[i // 26 % 26] + letters[i % 26])
+    return "(" + "|".join(words) + ")"
+
+
+def repeat(n):
+    return "[0-9]{%d}" % n
+
+
+def nested_star(n):
+    # ((a*b)*c)* ... with a new letter at every level, so the stars do not fold.
+    letters = string.ascii_lowercase
+    pattern = "a"
+    for i in range(n):
+        pattern = "(%s)*%s" % (pattern, letters[(i + 1) % len(letters)])
+    return pattern
+
+
+FAMILIES = {
+    "literal": (literal, [8, 16, 32, 64, 128]),
+    "alternation": (alternation, [2, 4, 8, 16, 32]),
+    "repeat": (repeat, [4, 8, 16, 32, 64]),
+    "nested_star": (nested_star, [1, 2, 4, 8, 16]),
+}
+
+
+def char_literal(c):
+    if c in "\\'":
+        return "'\\%s'" % c
+    return "'%s'" % c
+
+
+def translation_unit(pattern, stage):
+    lines = [
+        '#include "regex.hpp"',
+        '#include "parser.hpp"',
+    ]
+    if pattern is None:
+        lines.append("int main() { return 0; }")
+        return "\n".join(lines) + "\n"
+    lines += [
+        "using P = ParseRegex<%s>;" % ", ".join(char_literal(c) for c in pattern),
+        "using R = typename PatternOf<P>::Type;",
+    ]
+    if stage == "counting":
+        lines.append("using C = Regex<R, CountingEngine>;")
+        lines.append("int main(int, char **argv) { return C::match(argv[0]) + C::search(argv[0]); }")
+        return "\n".join(lines) + "\n"
+    if STAGES.index(stage) >= STAGES.index("subset"):
+        lines.append("static_assert(NFAToDFA<R>::TransitionTable::Table.size() > 0);")
+    if STAGES.index(stage) >= STAGES.index("minimize"):
+        lines.append("static_assert(MinimizeDFA<NFAToDFA<R>>::TransitionTable::Table.size() > 0);")
+    if stage == "full":
+        lines.append("int main(int, char **argv) { return P::match(argv[0]) + P::search(argv[0]); }")
+    else:
+        lines.append("int main() { return 0; }")
+    return "\n".join(lines) + "\n"
+
+
+def compile_once(command, timeout):
+    """Returns (status, seconds, peak RSS in KiB, first error line)."""
+    with tempfile.TemporaryFile() as errors:
+        start = time.monotonic()
+        process = subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=errors, start_new_session=True)
+        # wait4 reports the peak RSS of the driver and of the compiler it ran.
+        deadline = start + timeout
+        while True:
+            pid, status, usage = os.wait4(process.pid, os.WNOHANG)
+            if pid != 0:
+                break
+            if time.monotonic() > deadline:
+                os.killpg(process.pid, signal.SIGKILL)
+                pid, status, usage = os.wait4(process.pid, 0)
+                return "timeout", time.monotonic() - start, usage.ru_maxrss, ""
+            time.sleep(0.02)
+        seconds = time.monotonic() - start
+        process.returncode = os.waitstatus_to_exitcode(status)
+        if process.returncode == 0:
+            return "ok", seconds, usage.ru_maxrss, ""
+        errors.seek(0)
+        first = ""
+        for line in errors.read().decode(errors="replace").splitlines():
+            if "error" in line:
+                first = line.strip()
+                break
+        return "error", seconds, usage.ru_maxrss, first
+
+
+def run(args):
+    families = args.family or list(FAMILIES)
+    for family in families:
+        if family not in FAMILIES:
+            sys.exit("unknown family %s, expected one of %s" % (family, ", ".join(FAMILIES)))
+    stages = args.stage or STAGES
+    compiler = shlex.split(args.cxx) + ["-std=c++17"] + shlex.split(args.flags) + ["-I", ROOT]
+    rows = []
+    with tempfile.TemporaryDirectory() as directory:
+        jobs = [("include", 0, "", None)]
+        for family in families:
+            generate, sizes = FAMILIES[family]
+            for n in args.sizes or sizes:
+                for stage in stages:
+                    jobs.append((family, n, stage, generate(n)))
+        for family, n, stage, pattern in jobs:
+            source = os.path.join(directory, "%s_%d_%s.cpp" % (family, n, stage))
+            with open(source, "w") as file:
+                file.write(translation_unit(pattern, stage))
+            command = compiler + ["-c", source, "-o", os.devnull]
+            if args.time_trace:
+                command += ["-ftime-trace", "-ftime-trace-granularity=%d" % args.time_trace_granularity]
+            status, seconds, rss, error = compile_once(command, args.timeout)
+            if args.time_trace and status == "ok":
+                trace = source[:-len(".cpp")] + ".json"
+                if os.path.exists(trace):
+                    os.makedirs(args.time_trace, exist_ok=True)
+                    os.replace(trace, os.path.join(args.time_trace, os.path.basename(trace)))
+            row = {
+                "family": family,
+                "n": n,
+                "stage": stage,
+                "status": status,
+                "seconds": "%.3f" % seconds,
+                "peak_rss_kib": rss,
+                "pattern": pattern or "",
+                "error": error,
+            }
+            rows.append(row)
+            print("%-12s %4d %-9s %-7s %8.2fs %8d KiB" % (family, n, stage, status, seconds, rss), file=sys.stderr)
+    return rows
+
+
+def compare(rows, path, tolerance):
+    with open(path, newline="") as file:
+        old = {(r["family"], r["n"], r["stage"]): r for r in csv.DictReader(file)}
+    regressions = []
+    for row in rows:
+        before = old.get((row["family"], str(row["n"]), row["stage"]))
+        if before is None or before["status"] != "ok":
+            continue
+        if row["status"] != "ok":
+            regressions.append("%s %s %s: %s, was ok" % (row["family"], row["n"], row["stage"], row["status"]))
+        elif float(row["seconds"]) > tolerance * max(float(before["seconds"]), 0.1):
+            regressions.append("%s %s %s: %ss, was %ss" % (row["family"], row["n"], row["stage"], row["seconds"], before["seconds"]))
+    for regression in regressions:
+        print("regression: " + regression, file=sys.stderr)
+    return not regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("-o", "--output", help="CSV file to write, stdout by default")
+    parser.add_argument("--cxx", default=os.environ.get("CXX", "g++"), help="compiler command (default $CXX or g++)")
+    parser.add_argument("--flags", default="-O2", help="extra compiler flags (default -O2)")
+    parser.add_argument("--family", action="append", help="family to run, may be repeated (default all)")
+    parser.add_argument("--stage", action="append", choices=STAGES, help="stage to run, may be repeated (default all)")
+    parser.add_argument("--sizes", type=lambda s: [int(n) for n in s.split(",")], help="comma separated sizes for every family")
+    parser.add_argument("--timeout", type=float, default=600, help="seconds before a compile is killed (default 600)")
+    parser.add_argument("--time-trace", metavar="DIR", help="pass -ftime-trace (Clang) and keep the traces in DIR")
+    parser.add_argument("--time-trace-granularity", type=int, default=500, help="microseconds (default 500)")
+    parser.add_argument("--compare", metavar="CSV", help="fail on regressions against an earlier report")
+    parser.add_argument("--tolerance", type=float, default=1.5, help="allowed slowdown factor for --compare (default 1.5)")
+    args = parser.parse_args()
+
+    rows = run(args)
+    fields = ["family", "n", "stage", "status", "seconds", "peak_rss_kib", "pattern", "error"]
+    output = open(args.output, "w", newline="") if args.output else sys.stdout
+    with output:
+        writer = csv.DictWriter(output, fieldnames=fields)
+        writer.writeheader()
+        writer.writerows(rows)
+    if args.compare and not compare(rows, args.compare, args.tolerance):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,729 @@
+// Runtime throughput of the engines on synthetic corpora, next to std::regex
+// and hand-written code doing the same job. Every benchmark prints bytes per
+// second, nanoseconds per operation (a line, a chunk, a match or a token) and
+// a check value, which should agree across implementations of the same job.
+//
+//     g++ -std=c++17 -O2 -Wall -Wextra -I. bench/throughput.cpp -o throughput
+//     ./throughput [--size MB] [--time SECONDS] [filter]
+//
+// Only benchmarks whose "name implementation" contains filter are run.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "regex.hpp"
+#include "parser.hpp"
+#include "runtime.hpp"
+#include "lex.hpp"
+
+namespace {
+
+struct Corpus {
+    std::string text;
+    std::vector<std::string_view> lines;
+    void split() {
+        std::string_view view = text;
+        for (size_t pos = 0; pos < view.size();) {
+            size_t end = view.find('\n', pos);
+            if (end == std::string_view::npos) {
+                end = view.size();
+            }
+            lines.push_back(view.substr(pos, end - pos));
+            pos = end + 1;
+        }
+    }
+};
+
+std::mt19937_64 &random_engine() {
+    static std::mt19937_64 Engine(20261017);
+    return Engine;
+}
+
+size_t uniform(size_t low, size_t high) {
+    return std::uniform_int_distribution<size_t>(low, high)(random_engine());
+}
+
+void append_word(std::string &out, size_t low, size_t high) {
+    for (size_t n = uniform(low, high); n > 0; --n) {
+        out += static_cast<char>('a' + uniform(0, 25));
+    }
+}
+
+void append_digits(std::string &out, size_t low, size_t high) {
+    for (size_t n = uniform(low, high); n > 0; --n) {
+        out += static_cast<char>('0' + uniform(0, 9));
+    }
+}
+
+// Lines like "2026-10-17 08:15:42 INFO 10.0.3.7 user=abc took 12ms", with
+// ERROR lines, some of them timeouts, mixed in.
+Corpus log_lines(size_t bytes) {
+    static const char *Levels[] = {"INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR"};
+    Corpus corpus;
+    while (corpus.text.size() < bytes) {
+        std::string &out = corpus.text;
+        out += "2026-10-";
+        append_digits(out, 2, 2);
+        out += ' ';
+        append_digits(out, 2, 2);
+        out += ':';
+        append_digits(out, 2, 2);
+        out += ':';
+        append_digits(out, 2, 2);
+        out += ' ';
+        out += Levels[uniform(0, 5)];
+        out += ' ';
+        for (int i = 0; i < 4; ++i) {
+            append_digits(out, 1, 3);
+            out += i < 3 ? '.' : ' ';
+        }
+        out += "user=";
+        append_word(out, 3, 10);
+        out += uniform(0, 3) == 0 ? " timeout after " : " took ";
+        append_digits(out, 1, 4);
+        out += "ms\n";
+    }
+    corpus.split();
+    return corpus;
+}
+
+// One number per line, in the syntax of Decimal, with a quarter of them broken.
+Corpus numbers(size_t bytes) {
+    Corpus corpus;
+    while (corpus.text.size() < bytes) {
+        std::string &out = corpus.text;
+        if (uniform(0, 1)) {
+            out += uniform(0, 1) ? '-' : '+';
+        }
+        append_digits(out, 1, 8);
+        if (uniform(0, 1)) {
+            out += '.';
+            append_digits(out, 0, 6);
+        }
+        if (uniform(0, 2) == 0) {
+            out += 'e';
+            append_digits(out, 1, 2);
+        }
+        if (uniform(0, 3) == 0) {
+            out.insert(out.end() - uniform(1, 2), 'x');
+        }
+        out += '\n';
+    }
+    corpus.split();
+    return corpus;
+}
+
+// Numbers of exactly length digits, one per line, with a quarter of them
+// broken near the end, so that every line is read to its end either way.
+Corpus digit_lines(size_t bytes, size_t length) {
+    Corpus corpus;
+    while (corpus.text.size() < bytes) {
+        std::string &out = corpus.text;
+        append_digits(out, length, length);
+        if (uniform(0, 3) == 0) {
+            out[out.size() - uniform(1, 2)] = 'x';
+        }
+        out += '\n';
+    }
+    corpus.split();
+    return corpus;
+}
+
+// Identifiers followed by the rest of a statement, one per line.
+Corpus identifiers(size_t bytes) {
+    static const char *Rests[] = {" = 1;", "(x, y);", ".field", "[i] += 2;", " "};
+    Corpus corpus;
+    while (corpus.text.size() < bytes) {
+        std::string &out = corpus.text;
+        out += static_cast<char>('a' + uniform(0, 25));
+        for (size_t n = uniform(0, 15); n > 0; --n) {
+            size_t c = uniform(0, 37);
+            out += c < 26 ? static_cast<char>('a' + c) : c < 36 ? static_cast<char>('0' + c - 26) : '_';
+        }
+        out += Rests[uniform(0, 4)];
+        out += '\n';
+    }
+    corpus.split();
+    return corpus;
+}
+
+// Random bytes with "HTTP/1.1 200" planted every 64 KiB or so, cut into 4 KiB
+// chunks as if they were packets.
+Corpus binary(size_t bytes) {
+    Corpus corpus;
+    corpus.text.resize(bytes);
+    for (char &c : corpus.text) {
+        c = static_cast<char>(uniform(0, 255));
+    }
+    static const char Needle[] = "HTTP/1.1 200";
+    for (size_t pos = uniform(0, 65536); pos + sizeof(Needle) < bytes; pos += uniform(1, 131072)) {
+        std::memcpy(&corpus.text[pos], Needle, sizeof(Needle) - 1);
+    }
+    std::string_view view = corpus.text;
+    for (size_t pos = 0; pos < bytes; pos += 4096) {
+        corpus.lines.push_back(view.substr(pos, 4096));
+    }
+    return corpus;
+}
+
+// A small expression language: identifiers, numbers, operators and spaces.
+Corpus source_code(size_t bytes) {
+    static const char *Operators[] = {"+", "-", "*", "/", "=", "==", "(", ")", ";"};
+    Corpus corpus;
+    while (corpus.text.size() < bytes) {
+        std::string &out = corpus.text;
+        switch (uniform(0, 2)) {
+        case 0:
+            append_word(out, 1, 12);
+            break;
+        case 1:
+            append_digits(out, 1, 6);
+            break;
+        default:
+            out += Operators[uniform(0, 8)];
+        }
+        out += uniform(0, 7) == 0 ? "\n" : " ";
+    }
+    corpus.split();
+    return corpus;
+}
+
+double MinSeconds = 0.5;
+const char *Filter = "";
+
+// Runs job until MinSeconds have passed and prints the throughput over bytes
+// and ops per run. job returns the check value.
+template <typename F>
+void run(const char *name, const char *implementation, size_t bytes, size_t ops, F &&job) {
+    std::string label = std::string(name) + " " + implementation;
+    if (label.find(Filter) == std::string::npos) {
+        return;
+    }
+    using Clock = std::chrono::steady_clock;
+    size_t check = job();
+    size_t runs = 0;
+    Clock::time_point start = Clock::now();
+    double seconds = 0;
+    do {
+        volatile size_t sink = job();
+        (void) sink;
+        ++runs;
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (seconds < MinSeconds);
+    double per_run = seconds / runs;
+    std::printf("%-22s %-16s %10.1f MB/s %10.1f ns/op %12zu\n",
+                name, implementation, bytes / per_run / 1e6, per_run * 1e9 / ops, check);
+    std::fflush(stdout);
+}
+
+template <typename F>
+size_t count_lines(const Corpus &corpus, F &&accept) {
+    size_t count = 0;
+    for (std::string_view line : corpus.lines) {
+        count += accept(line);
+    }
+    return count;
+}
+
+template <typename F>
+size_t sum_lines(const Corpus &corpus, F &&measure) {
+    size_t sum = 0;
+    for (std::string_view line : corpus.lines) {
+        sum += measure(line);
+    }
+    return sum;
+}
+
+size_t prefix_length(size_t length) {
+    return length == std::string_view::npos ? 0 : length;
+}
+
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool is_word(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || is_digit(c) || c == '_';
+}
+
+// ^[+\-]?[0-9]+(.[0-9]*)?([eE][+\-]?[0-9]+)?$
+using DecimalPattern = Concat<
+    Begin,
+    Option<CharClass<'+', '-'>>,
+    Plus<Digit>,
+    Option<Concat<Char<'.'>, Star<Digit>>>,
+    Option<Concat<CharClass<'e', 'E'>, Option<CharClass<'+', '-'>>, Plus<Digit>>>,
+    End
+>;
+const char DecimalSyntax[] = "^[+\\-]?[0-9]+(.[0-9]*)?([eE][+\\-]?[0-9]+)?$";
+
+bool hand_decimal(std::string_view s) {
+    size_t i = 0;
+    if (i < s.size() && (s[i] == '+' || s[i] == '-')) {
+        ++i;
+    }
+    size_t digits = i;
+    for (; i < s.size() && is_digit(s[i]); ++i);
+    if (i == digits) {
+        return false;
+    }
+    if (i < s.size() && s[i] == '.') {
+        for (++i; i < s.size() && is_digit(s[i]); ++i);
+    }
+    if (i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+        ++i;
+        if (i < s.size() && (s[i] == '+' || s[i] == '-')) {
+            ++i;
+        }
+        digits = i;
+        for (; i < s.size() && is_digit(s[i]); ++i);
+        if (i == digits) {
+            return false;
+        }
+    }
+    return i == s.size();
+}
+
+void bench_match(size_t bytes) {
+    Corpus corpus = numbers(bytes);
+    size_t size = corpus.text.size();
+    size_t ops = corpus.lines.size();
+    const char *name = "match decimal";
+    run(name, "dfa", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) { return Regex<DecimalPattern>::match(s.data(), s.size()); });
+    });
+    run(name, "direct-coded", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) { return Regex<DecimalPattern, DirectCodedEngine>::match(s.data(), s.size()); });
+    });
+    run(name, "bit-parallel", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) { return Regex<DecimalPattern, BitParallelEngine>::match(s.data(), s.size()); });
+    });
+    run(name, "lazy-dfa", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) { return Regex<DecimalPattern, LazyDFAEngine<>>::match(s.data(), s.size()); });
+    });
+    std::vector<char> out(ops);
+    run(name, "dfa match_batch", size, ops, [&] {
+        Regex<DecimalPattern>::match_batch(corpus.lines, out);
+        size_t count = 0;
+        for (char matched : out) {
+            count += matched;
+        }
+        return count;
+    });
+    RuntimeRegex runtime(DecimalSyntax);
+    run(name, "runtime", size, ops, [&] {
+        return count_lines(corpus, [&](std::string_view s) { return runtime.match(s.data(), s.size()); });
+    });
+    std::regex standard("[+\\-]?[0-9]+(\\.[0-9]*)?([eE][+\\-]?[0-9]+)?", std::regex::optimize);
+    run(name, "std::regex", size, ops, [&] {
+        return count_lines(corpus, [&](std::string_view s) { return std::regex_match(s.begin(), s.end(), standard); });
+    });
+    run(name, "hand-written", size, ops, [&] {
+        return count_lines(corpus, hand_decimal);
+    });
+}
+
+// match_batch against a loop of match over lines of one length. The lanes
+// only overlap their loads for as long as the shortest of them runs, so the
+// gain grows with the length of the inputs.
+void bench_match_batch(size_t bytes) {
+    for (size_t length : {20, 40, 64, 200}) {
+        Corpus corpus = digit_lines(bytes, length);
+        size_t size = corpus.text.size();
+        size_t ops = corpus.lines.size();
+        std::string name = "match " + std::to_string(length) + " digits";
+        run(name.c_str(), "dfa", size, ops, [&] {
+            return count_lines(corpus, [](std::string_view s) { return Regex<DecimalPattern>::match(s.data(), s.size()); });
+        });
+        std::vector<char> out(ops);
+        run(name.c_str(), "dfa match_batch", size, ops, [&] {
+            Regex<DecimalPattern>::match_batch(corpus.lines, out);
+            size_t count = 0;
+            for (char matched : out) {
+                count += matched;
+            }
+            return count;
+        });
+    }
+}
+
+// ^[+\-]?[0-9]{1,1000}(.[0-9]{0,1000})?$, whose DFA is too large to build at
+// compile time.
+using BoundedPattern = Concat<
+    Begin,
+    Option<CharClass<'+', '-'>>,
+    Repeat<Digit, 1, 1000>,
+    Option<Concat<Char<'.'>, Repeat<Digit, 0, 1000>>>,
+    End
+>;
+
+bool hand_bounded(std::string_view s) {
+    size_t i = 0;
+    if (i < s.size() && (s[i] == '+' || s[i] == '-')) {
+        ++i;
+    }
+    size_t digits = i;
+    for (; i < s.size() && is_digit(s[i]); ++i);
+    if (i == digits || i - digits > 1000) {
+        return false;
+    }
+    if (i < s.size() && s[i] == '.') {
+        digits = ++i;
+        for (; i < s.size() && is_digit(s[i]); ++i);
+        if (i - digits > 1000) {
+            return false;
+        }
+    }
+    return i == s.size();
+}
+
+void bench_match_bounded(size_t bytes) {
+    Corpus corpus = numbers(bytes);
+    size_t size = corpus.text.size();
+    size_t ops = corpus.lines.size();
+    const char *name = "match bounded";
+    run(name, "counting", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) { return Regex<BoundedPattern, CountingEngine>::match(s.data(), s.size()); });
+    });
+    RuntimeRegex runtime("^[+\\-]?[0-9]{1,1000}(.[0-9]{0,1000})?$");
+    run(name, "runtime", size, ops, [&] {
+        return count_lines(corpus, [&](std::string_view s) { return runtime.match(s.data(), s.size()); });
+    });
+    std::regex standard("[+\\-]?[0-9]{1,1000}(\\.[0-9]{0,1000})?", std::regex::optimize);
+    run(name, "std::regex", size, ops, [&] {
+        return count_lines(corpus, [&](std::string_view s) { return std::regex_match(s.begin(), s.end(), standard); });
+    });
+    run(name, "hand-written", size, ops, [&] {
+        return count_lines(corpus, hand_bounded);
+    });
+}
+
+// [a-zA-Z_][a-zA-Z0-9_]*
+using IdentifierPattern = Concat<
+    CharClassUnion<Letter, Char<'_'>>,
+    Star<CharClassUnion<Letter, Digit, Char<'_'>>>
+>;
+
+void bench_match_prefix(size_t bytes) {
+    Corpus corpus = identifiers(bytes);
+    size_t size = corpus.text.size();
+    size_t ops = corpus.lines.size();
+    const char *name = "match_prefix ident";
+    run(name, "dfa", size, ops, [&] {
+        return sum_lines(corpus, [](std::string_view s) { return prefix_length(Regex<IdentifierPattern>::match_prefix(s.data(), s.size())); });
+    });
+    run(name, "direct-coded", size, ops, [&] {
+        return sum_lines(corpus, [](std::string_view s) { return prefix_length(Regex<IdentifierPattern, DirectCodedEngine>::match_prefix(s.data(), s.size())); });
+    });
+    run(name, "bit-parallel", size, ops, [&] {
+        return sum_lines(corpus, [](std::string_view s) { return prefix_length(Regex<IdentifierPattern, BitParallelEngine>::match_prefix(s.data(), s.size())); });
+    });
+    run(name, "lazy-dfa", size, ops, [&] {
+        return sum_lines(corpus, [](std::string_view s) { return prefix_length(Regex<IdentifierPattern, LazyDFAEngine<>>::match_prefix(s.data(), s.size())); });
+    });
+    RuntimeRegex runtime("[a-zA-Z_][a-zA-Z0-9_]*");
+    run(name, "runtime", size, ops, [&] {
+        return sum_lines(corpus, [&](std::string_view s) { return prefix_length(runtime.match_prefix(s.data(), s.size())); });
+    });
+    std::regex standard("[a-zA-Z_][a-zA-Z0-9_]*", std::regex::optimize);
+    run(name, "std::regex", size, ops, [&] {
+        return sum_lines(corpus, [&](std::string_view s) {
+            std::match_results<std::string_view::const_iterator> m;
+            return std::regex_search(s.begin(), s.end(), m, standard, std::regex_constants::match_continuous) ? m.length(0) : 0;
+        });
+    });
+    run(name, "hand-written", size, ops, [&] {
+        return sum_lines(corpus, [](std::string_view s) {
+            if (s.empty() || is_digit(s[0]) || !is_word(s[0])) {
+                return size_t(0);
+            }
+            size_t i = 1;
+            for (; i < s.size() && is_word(s[i]); ++i);
+            return i;
+        });
+    });
+}
+
+// ERROR.*timeout
+using TimeoutPattern = Concat<
+    Char<'E'>, Char<'R'>, Char<'R'>, Char<'O'>, Char<'R'>,
+    Star<Any>,
+    Char<'t'>, Char<'i'>, Char<'m'>, Char<'e'>, Char<'o'>, Char<'u'>, Char<'t'>
+>;
+
+// TimeoutPattern for lines that were lowercased first.
+using LowerTimeoutPattern = Concat<
+    Char<'e'>, Char<'r'>, Char<'r'>, Char<'o'>, Char<'r'>,
+    Star<Any>,
+    Char<'t'>, Char<'i'>, Char<'m'>, Char<'e'>, Char<'o'>, Char<'u'>, Char<'t'>
+>;
+
+// [0-9]+.[0-9]+.[0-9]+.[0-9]+
+using AddressPattern = Concat<
+    Plus<Digit>, Char<'.'>, Plus<Digit>, Char<'.'>, Plus<Digit>, Char<'.'>, Plus<Digit>
+>;
+
+void bench_search(size_t bytes) {
+    Corpus corpus = log_lines(bytes);
+    size_t size = corpus.text.size();
+    size_t ops = corpus.lines.size();
+    const char *name = "search log line";
+    run(name, "dfa", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) { return Regex<TimeoutPattern>::search(s.data(), s.size()); });
+    });
+    run(name, "lazy-dfa", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) { return Regex<TimeoutPattern, LazyDFAEngine<>>::search(s.data(), s.size()); });
+    });
+    RuntimeRegex runtime("ERROR[^\\n]*timeout");
+    run(name, "runtime", size, ops, [&] {
+        return count_lines(corpus, [&](std::string_view s) { return runtime.search(s.data(), s.size()); });
+    });
+    std::regex standard("ERROR.*timeout", std::regex::optimize);
+    run(name, "std::regex", size, ops, [&] {
+        return count_lines(corpus, [&](std::string_view s) { return std::regex_search(s.begin(), s.end(), standard); });
+    });
+    run(name, "hand-written", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) {
+            size_t error = s.find("ERROR");
+            return error != std::string_view::npos && s.find("timeout", error + 5) != std::string_view::npos;
+        });
+    });
+
+    // The same regardless of case, folded into the DFA or by lowercasing a copy
+    // of every line first.
+    name = "search icase line";
+    run(name, "dfa", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) { return Regex<ICase<TimeoutPattern>>::search(s.data(), s.size()); });
+    });
+    run(name, "lazy-dfa", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) { return Regex<ICase<TimeoutPattern>, LazyDFAEngine<>>::search(s.data(), s.size()); });
+    });
+    run(name, "dfa lowercased", size, ops, [&] {
+        std::string lower;
+        return count_lines(corpus, [&](std::string_view s) {
+            lower.assign(s.begin(), s.end());
+            for (char &c : lower) {
+                c = c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+            }
+            return Regex<LowerTimeoutPattern>::search(lower.data(), lower.size());
+        });
+    });
+    std::regex standard_icase("ERROR.*timeout", std::regex::optimize | std::regex::icase);
+    run(name, "std::regex", size, ops, [&] {
+        return count_lines(corpus, [&](std::string_view s) { return std::regex_search(s.begin(), s.end(), standard_icase); });
+    });
+
+    // Counts every address in the whole corpus rather than line by line.
+    size_t addresses = corpus.lines.size();
+    name = "find_all address";
+    std::string_view text = corpus.text;
+    run(name, "dfa", size, addresses, [&] {
+        size_t count = 0;
+        for (std::string_view match : Regex<AddressPattern>::find_all(text)) {
+            count += match.size();
+        }
+        return count;
+    });
+    std::regex address("[0-9]+\\.[0-9]+\\.[0-9]+\\.[0-9]+", std::regex::optimize);
+    run(name, "std::regex", size, addresses, [&] {
+        size_t count = 0;
+        using Iterator = std::regex_iterator<std::string_view::const_iterator>;
+        for (Iterator it(text.begin(), text.end(), address), end; it != end; ++it) {
+            count += it->length(0);
+        }
+        return count;
+    });
+    run(name, "hand-written", size, addresses, [&] {
+        size_t count = 0;
+        for (size_t i = 0; i < text.size();) {
+            // Four dot-separated runs of digits, starting at a run of digits.
+            size_t j = i;
+            int groups = 0;
+            for (; groups < 4; ++groups) {
+                size_t digits = j;
+                for (; j < text.size() && is_digit(text[j]); ++j);
+                if (j == digits || (groups < 3 && (j == text.size() || text[j] != '.'))) {
+                    break;
+                }
+                if (groups < 3) {
+                    ++j;
+                }
+            }
+            if (groups == 4) {
+                count += j - i;
+                i = j;
+            } else {
+                for (++i; i < text.size() && is_digit(text[i]) && is_digit(text[i - 1]); ++i);
+            }
+        }
+        return count;
+    });
+}
+
+using StatusPattern = Concat<
+    Char<'H'>, Char<'T'>, Char<'T'>, Char<'P'>, Char<'/'>, Char<'1'>, Char<'.'>, Char<'1'>, Char<' '>,
+    Char<'2'>, Digit, Digit
+>;
+
+void bench_binary(size_t bytes) {
+    Corpus corpus = binary(bytes);
+    size_t size = corpus.text.size();
+    size_t ops = corpus.lines.size();
+    const char *name = "search binary chunk";
+    run(name, "dfa", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) { return Regex<StatusPattern>::search(s.data(), s.size()); });
+    });
+    run(name, "lazy-dfa", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) { return Regex<StatusPattern, LazyDFAEngine<>>::search(s.data(), s.size()); });
+    });
+    RuntimeRegex runtime("HTTP/1.1 2[0-9][0-9]");
+    run(name, "runtime", size, ops, [&] {
+        return count_lines(corpus, [&](std::string_view s) { return runtime.search(s.data(), s.size()); });
+    });
+    std::regex standard("HTTP/1\\.1 2[0-9][0-9]", std::regex::optimize);
+    run(name, "std::regex", size, ops, [&] {
+        return count_lines(corpus, [&](std::string_view s) { return std::regex_search(s.begin(), s.end(), standard); });
+    });
+    run(name, "hand-written", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) {
+            for (size_t pos = s.find("HTTP/1.1 2"); pos != std::string_view::npos; pos = s.find("HTTP/1.1 2", pos + 1)) {
+                if (pos + 12 <= s.size() && is_digit(s[pos + 10]) && is_digit(s[pos + 11])) {
+                    return true;
+                }
+            }
+            return false;
+        });
+    });
+}
+
+// A frame marker of a made-up binary protocol: 0xfe, a type byte from 0x80 to
+// 0x8f and a length below 32. The chunks are searched as unsigned char and
+// std::byte buffers, as they would come off the wire.
+using FramePattern = Concat<Char<'\xfe'>, Range<0x80, 0x8f>, Range<0x00, 0x1f>>;
+
+const unsigned char *packet(std::string_view s) {
+    return reinterpret_cast<const unsigned char *>(s.data());
+}
+
+void bench_packets(size_t bytes) {
+    Corpus corpus = binary(bytes);
+    size_t size = corpus.text.size();
+    size_t ops = corpus.lines.size();
+    const char *name = "search packet bytes";
+    run(name, "dfa", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) { return Regex<FramePattern>::search(packet(s), s.size()); });
+    });
+    run(name, "lazy-dfa", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) {
+            return Regex<FramePattern, LazyDFAEngine<>>::search(reinterpret_cast<const std::byte *>(s.data()), s.size());
+        });
+    });
+    // The runtime syntax has no hex escapes, so the pattern holds the raw bytes.
+    static const char Pattern[] = "\xfe[\x80-\x8f][\0-\x1f]";
+    RuntimeRegex runtime(std::string_view(Pattern, sizeof(Pattern) - 1));
+    run(name, "runtime", size, ops, [&] {
+        return count_lines(corpus, [&](std::string_view s) { return runtime.search(packet(s), s.size()); });
+    });
+    run(name, "hand-written", size, ops, [&] {
+        return count_lines(corpus, [](std::string_view s) {
+            const unsigned char *data = packet(s);
+            for (size_t i = 0; i + 2 < s.size(); ++i) {
+                if (data[i] == 0xfe && (data[i + 1] & 0xf0) == 0x80 && data[i + 2] < 0x20) {
+                    return true;
+                }
+            }
+            return false;
+        });
+    });
+}
+
+using Word = Concat<Letter, Star<CharClassUnion<Letter, Digit>>>;
+using Number = Plus<Digit>;
+using Operator = Union<CharClass<'+', '-', '*', '/', '=', '(', ')', ';'>, Concat<Char<'='>, Char<'='>>>;
+using Space = Plus<CharClass<' ', '\n'>>;
+
+using ExpressionLexer = Lexer<std::tuple<
+    std::pair<Regex<Word>, SimpleTokenGetter<Word>>,
+    std::pair<Regex<Number>, SimpleTokenGetter<Number>>,
+    std::pair<Regex<Operator>, SimpleTokenGetter<Operator>>,
+    std::pair<Regex<Space>, SimpleTokenGetter<Space>>
+>>;
+
+void bench_lexer(size_t bytes) {
+    Corpus corpus = source_code(bytes);
+    std::string_view text = corpus.text;
+    size_t size = text.size();
+    auto hand_written = [&] {
+        size_t count = 0;
+        for (size_t i = 0; i < text.size(); ++count) {
+            char c = text[i];
+            size_t j = i + 1;
+            if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+                for (; j < text.size() && is_word(text[j]) && text[j] != '_'; ++j);
+            } else if (is_digit(c)) {
+                for (; j < text.size() && is_digit(text[j]); ++j);
+            } else if (c == ' ' || c == '\n') {
+                for (; j < text.size() && (text[j] == ' ' || text[j] == '\n'); ++j);
+            } else if (c == '=' && j < text.size() && text[j] == '=') {
+                ++j;
+            } else if (!std::strchr("+-*/=();", c)) {
+                break;
+            }
+            i = j;
+        }
+        return count;
+    };
+    size_t tokens = hand_written();
+    const char *name = "lex expression";
+    run(name, "lexer", size, tokens, [&] {
+        Token buffer[256];
+        size_t count = 0;
+        for (size_t pos = 0, n; (n = ExpressionLexer::lex(text, pos, buffer, 256)) > 0;) {
+            count += n;
+        }
+        return count;
+    });
+    std::regex standard("([a-zA-Z][a-zA-Z0-9]*)|([0-9]+)|(==|[-+*/=();])|([ \\n]+)", std::regex::optimize);
+    run(name, "std::regex", size, tokens, [&] {
+        size_t count = 0;
+        std::match_results<std::string_view::const_iterator> m;
+        for (auto it = text.begin(); it != text.end(); it += m.length(0), ++count) {
+            if (!std::regex_search(it, text.end(), m, standard, std::regex_constants::match_continuous) || m.length(0) == 0) {
+                break;
+            }
+        }
+        return count;
+    });
+    run(name, "hand-written", size, tokens, hand_written);
+}
+
+}
+
+int main(int argc, char **argv) {
+    size_t bytes = 1 << 20;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            bytes = static_cast<size_t>(std::atof(argv[++i]) * (1 << 20));
+        } else if (std::strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            MinSeconds = std::atof(argv[++i]);
+        } else {
+            Filter = argv[i];
+        }
+    }
+    std::printf("%-22s %-16s %15s %15s %12s\n", "benchmark", "implementation", "throughput", "time", "check");
+    bench_match(bytes);
+    bench_match_batch(bytes);
+    bench_match_bounded(bytes);
+    bench_match_prefix(bytes);
+    bench_search(bytes);
+    bench_binary(bytes);
+    bench_packets(bytes);
+    bench_lexer(bytes);
+    return 0;
+}
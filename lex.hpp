@@ -1,3 +1,4 @@
+#include <string_view>
 #include <utility>
 #include "regex.hpp"
 #include "util.hpp"
@@ -13,6 +14,15 @@ struct ConstexprToken {
     int type;
 };
 
+// A token of a runtime buffer: the index of the pattern that matched it and the
+// bytes it covers.
+struct Token {
+    constexpr Token() : type(0) {}
+    constexpr Token(int type_, std::string_view text_) : type(type_), text(text_) {}
+    int type;
+    std::string_view text;
+};
+
 template <char... C>
 struct StaticString {
     static constexpr char String[] = {C..., '\0'};
@@ -29,24 +39,54 @@ private:
     static constexpr size_t BufferSize = 128;
     static constexpr size_t Patterns = sizeof...(R);
     static constexpr bool IsPatternVoid[Patterns] = {std::is_void<T>::value...};
+    static constexpr size_t Capacity = 4096;
+    // All patterns run as one DFA, so every token is a single forward walk.
+    using DFA_ = ProductDFA<Capacity, ProductMode::Prefix, CompileRegex<typename PatternOf<R>::Type>...>;
+    // The pattern each DFA state accepts, or -1. When several patterns accept,
+    // the first one listed wins.
+    static constexpr ConstexprArray<int, DFA_::States> build_accepted() {
+        ConstexprArray<int, DFA_::States> Result;
+        for (size_t i = 0; i < DFA_::States; ++i) {
+            Result[i] = -1;
+            for (size_t k = Patterns; k > 0; --k) {
+                if (DFA_::Finals[i][k - 1]) {
+                    Result[i] = k - 1;
+                }
+            }
+        }
+        return Result;
+    }
+    static constexpr ConstexprArray<int, DFA_::States> Accepted = build_accepted();
+    // Returns the length of the longest token at pos, or 0 if no pattern
+    // matches there, and sets pattern to the pattern that matched. Maximal
+    // munch: the DFA runs until it dies, remembering the last position where
+    // some pattern accepted.
+    static constexpr size_t munch(const char *str, size_t length, size_t pos, size_t &pattern) {
+        typename DFA_::State state = DFA_::StartState;
+        size_t size = 0;
+        for (size_t i = pos; i < length && state != DFA_::DeadState; ++i) {
+            state = DFA_::next(state, str[i]);
+            int accepted = Accepted[state / DFA_::Stride];
+            if (accepted != -1) {
+                size = i + 1 - pos;
+                pattern = accepted;
+            }
+        }
+        return size;
+    }
     static constexpr std::tuple<bool, size_t, size_t, ConstexprArray<ConstexprToken, BufferSize>> constexpr_lex(const char *input, size_t pos) {
         ConstexprArray<ConstexprToken, BufferSize> res;
         size_t size = 0;
         bool has_finished = false;
+        size_t length = pos;
+        for (; input[length]; ++length);
         while (size < BufferSize) {
-            if (!input[pos]) {
+            if (pos == length) {
                 has_finished = true;
                 break;
             }
-            size_t match_size[Patterns] = {R::match_prefix(input + pos)...};
-            size_t max_size = 0;
             size_t max_pattern = 0;
-            for (size_t i = 0; i < Patterns; ++i){
-                if (match_size[i] > max_size) {
-                    max_size = match_size[i];
-                    max_pattern = i;
-                }
-            }
+            size_t max_size = munch(input, length, pos, max_pattern);
             if (max_size == 0) {
                 break;
             }
@@ -104,6 +144,79 @@ public:
     using Lex = typename LexImpl<S::String>::Type;
     template <const char *S>
     using LexCharArray = typename LexImpl<S>::Type;
+    // Lexes input from pos into out, at most capacity tokens, and returns how
+    // many were written. Tokens of patterns whose getter is void are skipped.
+    // pos is left after the last token read, so lexing continues with another
+    // call once the buffer is full; it stops short of input.size() where no
+    // pattern matches. Tokens refer to input, which must outlive them.
+    static constexpr size_t lex(std::string_view input, size_t &pos, Token *out, size_t capacity) {
+        size_t size = 0;
+        while (size < capacity && pos < input.size()) {
+            size_t pattern = 0;
+            size_t length = munch(input.data(), input.size(), pos, pattern);
+            if (length == 0) {
+                break;
+            }
+            if (!IsPatternVoid[pattern]) {
+                out[size++] = Token(pattern, input.substr(pos, length));
+            }
+            pos += length;
+        }
+        return size;
+    }
+    // Iterates over the tokens of a buffer, as lex would write them one after
+    // another. It ends at the end of the input or where no pattern matches;
+    // position() tells which. The iterator only refers to the buffer.
+    class TokenIterator {
+    public:
+        constexpr TokenIterator() : pos_(0), valid_(false) {}
+        constexpr explicit TokenIterator(std::string_view input) : input_(input), pos_(0), valid_(true) {
+            advance();
+        }
+        constexpr const Token &operator*() const {
+            return token_;
+        }
+        constexpr const Token *operator->() const {
+            return &token_;
+        }
+        constexpr TokenIterator &operator++() {
+            advance();
+            return *this;
+        }
+        constexpr bool operator==(const TokenIterator &other) const {
+            return valid_ == other.valid_ && (!valid_ || (input_.data() == other.input_.data() && pos_ == other.pos_));
+        }
+        constexpr bool operator!=(const TokenIterator &other) const {
+            return !(*this == other);
+        }
+        // Where lexing stands: after the current token, or where it stopped.
+        constexpr size_t position() const {
+            return pos_;
+        }
+    private:
+        constexpr void advance() {
+            valid_ = lex(input_, pos_, &token_, 1) == 1;
+        }
+        std::string_view input_;
+        size_t pos_;
+        Token token_;
+        bool valid_;
+    };
+    class TokenRange {
+    public:
+        constexpr explicit TokenRange(std::string_view input) : input_(input) {}
+        constexpr TokenIterator begin() const {
+            return TokenIterator(input_);
+        }
+        constexpr TokenIterator end() const {
+            return TokenIterator();
+        }
+    private:
+        std::string_view input_;
+    };
+    static constexpr TokenRange tokens(std::string_view input) {
+        return TokenRange(input);
+    }
 };
 
 template <typename T>
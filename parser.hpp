@@ -16,7 +16,8 @@ enum class ParserState {
     CharClassReduce,
     NegCharClassInitial,
     NegCharClassRange,
-    NegCharClassReduce
+    NegCharClassReduce,
+    Property
 };
 
 static constexpr char GetEscapeChar(char c) {
@@ -32,6 +33,28 @@ struct LeftParenthesesToken {};
 struct UnionToken {};
 struct LeftBracketToken {};
 
+// The name of a \p{...} class, collected one char at a time.
+template <char... Name>
+struct PropertyName {
+    static constexpr char String[] = {Name..., '\0'};
+};
+
+template <typename P, char C>
+struct AppendPropertyName;
+
+template <char... Name, char C>
+struct AppendPropertyName<PropertyName<Name...>, C> {
+    using Type = PropertyName<Name..., C>;
+};
+
+template <typename P>
+struct PropertyClass;
+
+template <char... Name>
+struct PropertyClass<PropertyName<Name...>> {
+    using Type = UProperty<unicode_property(std::string_view(PropertyName<Name...>::String, sizeof...(Name)))>;
+};
+
 template
 <
     typename Stack,
@@ -451,16 +474,16 @@ struct ParserIteration<
     C,
     Buffer...
 > {
-    template <char C_>
+    template <char C_, typename = void>
     struct SelectSymbol {
         using Type = Char<C_>;
     };
-    template <>
-    struct SelectSymbol<'^'> {
+    template <typename Dummy>
+    struct SelectSymbol<'^', Dummy> {
         using Type = Begin;
     };
-    template <>
-    struct SelectSymbol<'$'> {
+    template <typename Dummy>
+    struct SelectSymbol<'$', Dummy> {
         using Type = End;
     };
     using NextStack = TypeList::PushFront<
@@ -526,7 +549,7 @@ struct ParserIteration<
     using NextStack = TypeList::Set<
         Stack,
         0,
-        Range<C1, C>
+        Range<C1, static_cast<unsigned char>(C)>
     >;
     using Type = typename ParserIteration<
         NextStack,
@@ -705,16 +728,16 @@ struct ParserIteration<
     C,
     Buffer...
 > {
-    template <char C_>
+    template <char C_, typename = void>
     struct SelectSymbol {
         using Type = Char<C_>;
     };
-    template <>
-    struct SelectSymbol<'^'> {
+    template <typename Dummy>
+    struct SelectSymbol<'^', Dummy> {
         using Type = Begin;
     };
-    template <>
-    struct SelectSymbol<'$'> {
+    template <typename Dummy>
+    struct SelectSymbol<'$', Dummy> {
         using Type = End;
     };
     using NextStack = TypeList::PushFront<
@@ -780,7 +803,7 @@ struct ParserIteration<
     using NextStack = TypeList::Set<
         Stack,
         0,
-        Range<C1, C>
+        Range<C1, static_cast<unsigned char>(C)>
     >;
     using Type = typename ParserIteration<
         NextStack,
@@ -837,7 +860,7 @@ struct ParserIteration<
 > {
     using NextStack = TypeList::PushFront<
         TypeList::Tail<Stack, 2>,
-        CharClassComplement<CharClassUnion<StackTopFirst, StackTopSecond>>
+        CharClassUnion<StackTopFirst, StackTopSecond>
     >;
     using Type = typename ParserIteration<
         NextStack,
@@ -866,7 +889,103 @@ struct ParserIteration<
 > {
     using NextStack = TypeList::PushFront<
         TypeList::Tail<Stack, 2>,
-        StackTopFirst
+        CharClassComplement<StackTopFirst>
+    >;
+    using Type = typename ParserIteration<
+        NextStack,
+        Nil,
+        Nil,
+        ParenthesesCount,
+        ParserState::Initial,
+        Buffer...
+    >::Type;
+};
+
+template
+<
+    typename Stack,
+    typename StackTopFirst,
+    typename StackTopSecond,
+    int ParenthesesCount,
+    char... Buffer
+>
+struct ParserIteration<
+    Stack,
+    StackTopFirst,
+    StackTopSecond,
+    ParenthesesCount,
+    ParserState::Initial,
+    '\\', 'p', '{',
+    Buffer...
+> {
+    using NextStack = TypeList::PushFront<
+        Stack,
+        PropertyName<>
+    >;
+    using Type = typename ParserIteration<
+        NextStack,
+        Nil,
+        Nil,
+        ParenthesesCount,
+        ParserState::Property,
+        Buffer...
+    >::Type;
+};
+
+template
+<
+    typename Stack,
+    typename StackTopFirst,
+    typename StackTopSecond,
+    int ParenthesesCount,
+    char C,
+    char... Buffer
+>
+struct ParserIteration<
+    Stack,
+    StackTopFirst,
+    StackTopSecond,
+    ParenthesesCount,
+    ParserState::Property,
+    C,
+    Buffer...
+> {
+    using NextStack = TypeList::Set<
+        Stack,
+        0,
+        typename AppendPropertyName<TypeList::Get<Stack, 0>, C>::Type
+    >;
+    using Type = typename ParserIteration<
+        NextStack,
+        Nil,
+        Nil,
+        ParenthesesCount,
+        ParserState::Property,
+        Buffer...
+    >::Type;
+};
+
+template
+<
+    typename Stack,
+    typename StackTopFirst,
+    typename StackTopSecond,
+    int ParenthesesCount,
+    char... Buffer
+>
+struct ParserIteration<
+    Stack,
+    StackTopFirst,
+    StackTopSecond,
+    ParenthesesCount,
+    ParserState::Property,
+    '}',
+    Buffer...
+> {
+    using NextStack = TypeList::Set<
+        Stack,
+        0,
+        typename PropertyClass<TypeList::Get<Stack, 0>>::Type
     >;
     using Type = typename ParserIteration<
         NextStack,
@@ -928,16 +1047,16 @@ struct ParserIteration<
     C,
     Buffer...
 > {
-    template <char C_>
+    template <char C_, typename = void>
     struct SelectSymbol {
         using Type = Char<C_>;
     };
-    template <>
-    struct SelectSymbol<'^'> {
+    template <typename Dummy>
+    struct SelectSymbol<'^', Dummy> {
         using Type = Begin;
     };
-    template <>
-    struct SelectSymbol<'$'> {
+    template <typename Dummy>
+    struct SelectSymbol<'$', Dummy> {
         using Type = End;
     };
     using NextStack = TypeList::PushFront<
@@ -2,257 +2,81 @@
 #include <iostream>
 #include <array>
 #include <tuple>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <iterator>
+#include <algorithm>
+#include <vector>
 #include "util.hpp"
+#include "teddy.hpp"
+#include "utf8.hpp"
 
 constexpr int BeginSymbol = 256;
 constexpr int EndSymbol = 257;
 constexpr int Epsilon = 258;
 constexpr int SymbolsCount = 259;
 
-template <int StartState_, int FinalState_, int States_, typename TransitionTable_>
-struct NFA {
-    static constexpr int StartState = StartState_;
-    static constexpr int FinalState = FinalState_;
-    static constexpr int States = States_;
-    using TransitionTable = TransitionTable_;
-};
-
-using EmptyNFA = NFA<0, 1, 2,
-    TypeList::List<
-        TypeTypeMap::Map<TypeTypePair<std::integral_constant<int, Epsilon>, IntSet::Set<1>>>
-    >
->;
-
-template <int Symbol>
-using SymbolNFA = NFA<0, 1, 2,
-    TypeList::List<
-        TypeTypeMap::Map<TypeTypePair<std::integral_constant<int, Symbol>, IntSet::Set<1>>>
-    >
->;
-
-template <int N>
-struct TransitionTableAdder {
-    template <typename Key, typename Value>
-    using Add = IntSet::Add<Value, N>;
-    template <typename M>
-    using Type = TypeTypeMap::Transform<M, Add>;
-};
-
-template <typename NFA1, typename NFA2>
-using ConcatNFA = NFA<0, NFA1::States + NFA2::FinalState - 1, NFA1::States + NFA2::States - 1,
-    TypeList::Merge<
-        typename NFA1::TransitionTable,
-        TypeList::Transform<
-            typename NFA2::TransitionTable,
-            TransitionTableAdder<NFA1::States - 1>::template Type
-        >
-    >
->;
-
-template <typename... Args>
-struct UnionNFAImpl {
-    template <typename...>
-    struct StatesCounter;
-    template <typename Head, typename... Rest>
-    struct StatesCounter<Head, Rest...> {
-        static constexpr int States = StatesCounter<Rest...>::States + Head::States;
-        static constexpr int StartState = StatesCounter<Rest...>::StartState + Head::States;
-    };
-    template <typename Head>
-    struct StatesCounter<Head> {
-        static constexpr int States = Head::States + 2;
-        static constexpr int StartState = 1;
-    };
-    static constexpr int States = StatesCounter<Args...>::States;
-    template <typename...>
-    struct MergeTransitionTable;
-    template <typename Head, typename... Rest>
-    struct MergeTransitionTable<Head, Rest...> {
-        static constexpr int States = MergeTransitionTable<Rest...>::States + Head::States;
-        using Type = TypeList::Merge<
-            typename MergeTransitionTable<Rest...>::Type,
-            TypeList::Append<
-                TypeList::Transform<
-                    typename Head::TransitionTable,
-                    TransitionTableAdder<MergeTransitionTable<Rest...>::States>::template Type
-                >,
-                TypeTypeMap::Map<
-                    TypeTypePair<std::integral_constant<int, Epsilon>, IntSet::Set<StatesCounter<Args...>::States - 1>>
-                >
-            >
-        >;
-    };
-    template <typename Head>
-    struct MergeTransitionTable<Head> {
-        static constexpr int States = Head::States + 1;
-        using Type = TypeList::Append<
-            TypeList::Transform<
-                typename Head::TransitionTable,
-                TransitionTableAdder<1>::template Type
-            >,
-            TypeTypeMap::Map<
-                TypeTypePair<std::integral_constant<int, Epsilon>, IntSet::Set<StatesCounter<Args...>::States - 1>>
-            >
-        >;
-    };
-    template <typename...>
-    struct FirstTransitionSet;
-    template <typename Head, typename... Rest>
-    struct FirstTransitionSet<Head, Rest...> {
-        using Type = IntSet::Insert<
-            typename FirstTransitionSet<Rest...>::Type,
-            StatesCounter<Head, Rest...>::StartState
-        >;
-    };
-    template <typename Head>
-    struct FirstTransitionSet<Head> {
-        using Type = IntSet::Set<StatesCounter<Head>::StartState>;
-    };
-    using MergedTransitionTable = typename MergeTransitionTable<Args...>::Type;
-    using FirstSet = typename FirstTransitionSet<Args...>::Type;
-    using TransitionTable = TypeList::PushFront<
-        MergedTransitionTable,
-        TypeTypeMap::Map<
-            TypeTypePair<std::integral_constant<int, Epsilon>, FirstSet>
-        >
-    >;
-    using Type = NFA<0, StatesCounter<Args...>::States - 1, StatesCounter<Args...>::States,
-        TransitionTable
-    >;
-};
-
-template <typename... Args>
-using UnionNFA = typename UnionNFAImpl<Args...>::Type;
-
-template <typename NFA_>
-using StarNFA = NFA<0, NFA_::States + 1, NFA_::States + 2,
-    TypeList::Merge<
-        TypeList::List<
-            TypeTypeMap::Map<
-                TypeTypePair<
-                    std::integral_constant<int, Epsilon>,
-                    IntSet::Set<1, NFA_::States + 1>
-                >
-            >
-        >,
-        TypeList::Transform<
-            typename NFA_::TransitionTable,
-            TransitionTableAdder<1>::template Type
-        >,
-        TypeList::List<
-            TypeTypeMap::Map<
-                TypeTypePair<
-                    std::integral_constant<int, Epsilon>,
-                    IntSet::Set<1, NFA_::States + 1>
-                >
-            >
-        >
-    >
->;
-
-template <typename NFA_>
-using PlusNFA = NFA<0, NFA_::States, NFA_::States + 1,
-    TypeList::Append<
-        typename NFA_::TransitionTable,
-        TypeTypeMap::Map<
-            TypeTypePair<
-                std::integral_constant<int, Epsilon>,
-                IntSet::Set<0, NFA_::States>
-            >
-        >
-    >
->;
-
-template <typename NFA_>
-using OptionNFA = NFA<0, NFA_::States, NFA_::States + 1,
-    TypeList::PushFront<
-        TypeList::Transform<
-            typename NFA_::TransitionTable,
-            TransitionTableAdder<1>::template Type
-        >,
-        TypeTypeMap::Map<
-            TypeTypePair<
-                std::integral_constant<int, Epsilon>,
-                IntSet::Set<1, NFA_::States>
-            >
-        >
-    >
->;
-
-template <int... Args>
-using CharClassNFA = NFA<0, 1, 2,
-    TypeList::List<
-        TypeTypeMap::Map<
-            TypeTypePair<
-                std::integral_constant<int, Args>,
-                IntSet::Set<1>
-            >...
-        >
-    >
->;
-
-template <typename S>
-struct CharClassFromSetNFAImpl;
-
-template <template <int...> class S, int... Args>
-struct CharClassFromSetNFAImpl<S<Args...>> {
-    using Type = CharClassNFA<Args...>;
-};
-
-template <typename S>
-using CharClassFromSetNFA = typename CharClassFromSetNFAImpl<S>::Type;
-
-template <size_t States, size_t Symbols>
-using TransitionTable = ConstexprArray<ConstexprArray<int, Symbols>, States>;
-
-template <typename Subsets, typename Map, size_t Symbols, typename Index>
-struct BuildDFATransitionMapImpl;
-
-template <typename Subsets, typename Map, size_t Symbols, size_t... I>
-struct BuildDFATransitionMapImpl<Subsets, Map, Symbols, std::index_sequence<I...>> {
-    static constexpr ConstexprArray<int, Symbols> Build() {
-        return ConstexprArray<int, Symbols> (
-            int(TypeSet::Find<Subsets, TypeTypeMap::Get<Map, std::integral_constant<int, I>>>::Value)...
-        );
+// A set of indices below N, e.g. of the patterns of a RegexSet that matched or
+// of the positions of a Glushkov automaton.
+template <size_t N>
+struct PatternMask {
+    ConstexprArray<uint64_t, (N + 63) / 64> Words;
+    constexpr bool operator[](size_t i) const {
+        return Words[i / 64] >> (i % 64) & 1;
+    }
+    constexpr void set(size_t i) {
+        Words[i / 64] |= uint64_t(1) << (i % 64);
+    }
+    constexpr bool any() const {
+        for (size_t i = 0; i < Words.size(); ++i) {
+            if (Words[i] != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+    constexpr size_t count() const {
+        size_t Count = 0;
+        for (size_t i = 0; i < Words.size(); ++i) {
+            Count += __builtin_popcountll(Words[i]);
+        }
+        return Count;
+    }
+    constexpr PatternMask &operator|=(const PatternMask &Other) {
+        for (size_t i = 0; i < Words.size(); ++i) {
+            Words[i] |= Other.Words[i];
+        }
+        return *this;
+    }
+    constexpr PatternMask &operator&=(const PatternMask &Other) {
+        for (size_t i = 0; i < Words.size(); ++i) {
+            Words[i] &= Other.Words[i];
+        }
+        return *this;
+    }
+    constexpr PatternMask operator|(const PatternMask &Other) const {
+        PatternMask Result = *this;
+        return Result |= Other;
+    }
+    constexpr PatternMask operator&(const PatternMask &Other) const {
+        PatternMask Result = *this;
+        return Result &= Other;
+    }
+    constexpr bool operator==(const PatternMask &Other) const {
+        for (size_t i = 0; i < Words.size(); ++i) {
+            if (Words[i] != Other.Words[i]) {
+                return false;
+            }
+        }
+        return true;
     }
 };
 
-template <typename Subsets, typename Map, size_t Symbols>
-static constexpr ConstexprArray<int, Symbols> BuildDFATransitionMap() {
-    return BuildDFATransitionMapImpl<Subsets, Map, Symbols, std::make_index_sequence<Symbols>>::Build();
-}
-
-template <typename Subsets, typename SubsetTransitionTable>
-struct BuildDFATransitionTable;
-
-template <template <typename...> class L, typename... Args, typename SubsetTransitionTable>
-struct BuildDFATransitionTable<L<Args...>, SubsetTransitionTable> {
-    static constexpr size_t Size = L<Args...>::Size;
-    static constexpr TransitionTable<L<Args...>::Size, SymbolsCount> Table = TransitionTable<L<Args...>::Size, SymbolsCount>(
-        BuildDFATransitionMap<
-            L<Args...>,
-            TypeTypeMap::Get<
-                SubsetTransitionTable,
-                Args,
-                TypeTypeMap::Map<>
-            >,
-            SymbolsCount
-        >()...
-    );
-};
-
-template <template <typename...> class L, typename... Args, typename SubsetTransitionTable>
-constexpr TransitionTable<L<Args...>::Size, SymbolsCount> BuildDFATransitionTable<L<Args...>, SubsetTransitionTable>::Table;
-
-template <typename L>
-struct ExtractIntImpl {
-    template <typename T, typename R>
-    using F = IntSet::Insert<R, T::value>;
-    using Type = TypeList::Reduce<L, F, IntSet::Set<>>;
-};
-
-template <typename L>
-using ExtractInt = typename ExtractIntImpl<L>::Type;
+// Maps every byte to the column of the transition table that holds its transitions.
+// BeginSymbol and EndSymbol have columns of their own, given separately.
+using ByteClassMap = ConstexprArray<unsigned char, 256>;
 
 template <int StartState_, typename FinalStates_, typename TransitionTable_>
 struct DFA {
@@ -261,154 +85,6 @@ struct DFA {
     using TransitionTable = TransitionTable_;
 };
 
-template <typename NFA_>
-struct NFAToDFAImpl {
-    using NFATransitionTable = typename NFA_::TransitionTable;
-    template <bool HasNext_, typename NewStates, typename Visited>
-    struct EpsilonClosureImpl {
-        template <int S, typename T>
-        using Merge = IntSet::Union<
-            T,
-            TypeTypeMap::Get<
-                TypeList::Get<
-                    NFATransitionTable,
-                    S,
-                    TypeTypeMap::Map<>
-                >,
-                std::integral_constant<int, Epsilon>,
-                IntSet::Set<>
-            >
-        >;
-        using NextNewStates = IntSet::Diff<
-            IntSet::Reduce<NewStates, Merge, IntSet::Set<>>,
-            Visited
-        >;
-        using NextVisited = IntSet::Union<
-            Visited,
-            NextNewStates
-        >;
-        static constexpr bool HasNext = !std::is_same<NextNewStates, IntSet::Set<>>::value;
-        using Type = typename EpsilonClosureImpl<
-            HasNext,
-            NextNewStates,
-            NextVisited
-        >::Type;
-    };
-    template <typename NewStates, typename Visited>
-    struct EpsilonClosureImpl<false, NewStates, Visited> {
-        using Type = Visited;
-    };
-    template <typename States>
-    using EpsilonClosure = typename EpsilonClosureImpl<true, States, States>::Type;
-    using StartStates = EpsilonClosure<IntSet::Set<NFA_::StartState>>;
-    template <typename Subsets_, typename SubsetTransitionTable_>
-    struct IterationResult {
-        using Subsets = Subsets_;
-        using SubsetTransitionTable = SubsetTransitionTable_;
-    };
-    template <bool HasNext_, typename NewSubsets, typename Visited, typename SubsetTransitionTable>
-    struct Iteration {
-        template <typename Subset>
-        struct NewSTFromSubset {
-            template <int S, typename T>
-            using FindSymbols = IntSet::Union<
-                T,
-                ExtractInt<TypeTypeMap::Keys<TypeList::Get<NFATransitionTable, S, TypeTypeMap::Map<>>>>
-            >;
-            using Symbols = IntSet::Remove<
-                IntSet::Reduce<Subset, FindSymbols, IntSet::Set<>>,
-                Epsilon
-            >;
-            struct EmptyST {
-                using Subsets_ = TypeSet::Set<>;
-                using TransitionMap = TypeTypeMap::Map<>;
-            };
-            template <int S, typename T>
-            struct F {
-                template <int St, typename R>
-                using G = IntSet::Union<
-                    R,
-                    TypeTypeMap::Get<
-                        TypeList::Get<NFATransitionTable, St, TypeTypeMap::Map<>>,
-                        std::integral_constant<int, S>,
-                        IntSet::Set<>
-                    >
-                >;
-                using NewSubset = EpsilonClosure<IntSet::Reduce<Subset, G, IntSet::Set<>>>;
-                using Subsets_ = TypeSet::Insert<typename T::Subsets_, NewSubset>;
-                using TransitionMap = TypeTypeMap::Set<
-                    typename T::TransitionMap,
-                    std::integral_constant<int, S>,
-                    NewSubset
-                >;
-            };
-            using Type = IntSet::Reduce<Symbols, F, EmptyST>;
-        };
-        struct EmptyNext {
-            using NextNewSubsets_ = TypeSet::Set<>;
-            using NextSubsetTransitionTable_ = SubsetTransitionTable;
-        };
-        template <typename Subset, typename R>
-        struct F {
-            using NewTL = typename NewSTFromSubset<Subset>::Type;
-            using NextNewSubsets_ = TypeSet::Union<
-                typename R::NextNewSubsets_,
-                typename NewTL::Subsets_
-            >;
-            using NextSubsetTransitionTable_ = TypeTypeMap::Set<
-                typename R::NextSubsetTransitionTable_,
-                Subset,
-                typename NewTL::TransitionMap
-            >;
-        };
-        using Next = TypeList::Reduce<NewSubsets, F, EmptyNext>;
-        using NextNewSubsets = TypeSet::Diff<
-            typename Next::NextNewSubsets_,
-            Visited
-        >;
-        using NextTransitionTable = typename Next::NextSubsetTransitionTable_;
-        using NextVisited = TypeSet::Union<Visited, typename Next::NextNewSubsets_>;
-        static constexpr bool HasNext = !std::is_same<NextNewSubsets, TypeSet::Set<>>::value;
-        using Type = typename Iteration<HasNext, NextNewSubsets, NextVisited, NextTransitionTable>::Type;
-   };
-    template <typename NewSubsets, typename Visited, typename SubsetTransitionTable>
-    struct Iteration<false, NewSubsets, Visited, SubsetTransitionTable> {
-        using Type = IterationResult<
-            Visited,
-            SubsetTransitionTable
-        >;
-    };
-    using ST = typename Iteration<
-        true,
-        TypeSet::Set<StartStates>,
-        TypeSet::Set<StartStates>,
-        TypeTypeMap::Map<>
-    >::Type;
-    template <typename T, typename R>
-    struct FinalStatesImpl {
-        template <bool>
-        struct Branch {
-            using Type = IntSet::Insert<R, TypeSet::Find<typename ST::Subsets, T>::Value>;
-        };
-        template <>
-        struct Branch<false> {
-            using Type = R;
-        };
-        using Type = typename Branch<IntSet::Contains<T, NFA_::FinalState>::Value>::Type;
-    };
-    template <typename T, typename R>
-    using FinalStates = typename FinalStatesImpl<T, R>::Type;
-    using DFAFinalStates = TypeList::Reduce<typename ST::Subsets, FinalStates, IntSet::Set<>>;
-    using Type = DFA<
-        0,
-        DFAFinalStates,
-        BuildDFATransitionTable<typename ST::Subsets, typename ST::SubsetTransitionTable>
-    >;
-};
-
-template <typename NFA_>
-using NFAToDFA = typename NFAToDFAImpl<NFA_>::Type;
-
 template <size_t N, typename T>
 constexpr ConstexprArray<typename T::value_type, N> TruncateArray(T In) {
     ConstexprArray<typename T::value_type, N> Result;
@@ -418,12 +94,228 @@ constexpr ConstexprArray<typename T::value_type, N> TruncateArray(T In) {
     return Result;
 }
 
+// Thompson NFA of a regex in fixed-capacity arrays. ThompsonImpl<R>::build lays
+// out the States states of R from Offset, the first one being the start state
+// and the last one the final state. A state reads at most one class of symbols,
+// which leads to the state after it, and has at most two epsilon moves.
+template <size_t N>
+struct ThompsonNFA {
+    ConstexprArray<PatternMask<EndSymbol + 1>, N> Symbols;
+    ConstexprArray<ConstexprArray<size_t, 2>, N> Epsilon;
+    ConstexprArray<unsigned char, N> Epsilons;
+    constexpr void epsilon(size_t From, size_t To) {
+        Epsilon[From][Epsilons[From]++] = To;
+    }
+};
+
+template <typename R>
+struct ThompsonImpl;
+
+// Subset construction over the Thompson NFA of R, as constexpr functions over
+// bit sets of NFA states. Symbols read by the same NFA states share a column,
+// and the epsilon closure of every state is computed once up front. Subsets are
+// found by a breadth-first search that hashes them into twice as many slots as
+// it has room for subsets, once to count them and once more to fill the table,
+// which is the only part that becomes a type. Every pass allocates its arrays
+// in full, so the count starts with room for as many subsets as the NFA has
+// states and starts over in four times the room while it runs out, up to
+// MaxCapacity. The table is then filled in room for exactly the subsets found.
+template <typename R>
+struct NFAToDFAImpl {
+    static constexpr size_t MaxCapacity = 1 << 14;
+    static constexpr size_t NFAStates = ThompsonImpl<R>::States;
+    static constexpr size_t FinalState = NFAStates - 1;
+    using Subset = PatternMask<NFAStates>;
+    static constexpr ThompsonNFA<NFAStates> build_nfa() {
+        ThompsonNFA<NFAStates> Result;
+        ThompsonImpl<R>::build(Result, 0);
+        return Result;
+    }
+    static constexpr ThompsonNFA<NFAStates> Thompson = build_nfa();
+    static constexpr ConstexprArray<Subset, NFAStates> closures() {
+        ConstexprArray<Subset, NFAStates> Result;
+        ConstexprArray<size_t, NFAStates> Stack;
+        for (size_t s = 0; s < NFAStates; ++s) {
+            size_t Top = 0;
+            Stack[Top++] = s;
+            Result[s].set(s);
+            while (Top > 0) {
+                size_t t = Stack[--Top];
+                for (size_t k = 0; k < Thompson.Epsilons[t]; ++k) {
+                    size_t u = Thompson.Epsilon[t][k];
+                    if (!Result[s][u]) {
+                        Result[s].set(u);
+                        Stack[Top++] = u;
+                    }
+                }
+            }
+        }
+        return Result;
+    }
+    static constexpr ConstexprArray<Subset, NFAStates> Closures = closures();
+    // The states that read each symbol; symbols with the same readers share a column.
+    static constexpr ConstexprArray<Subset, EndSymbol + 1> readers() {
+        ConstexprArray<Subset, EndSymbol + 1> Result;
+        for (size_t s = 0; s < NFAStates; ++s) {
+            for (int Symbol = 0; Symbol <= EndSymbol; ++Symbol) {
+                if (Thompson.Symbols[s][Symbol]) {
+                    Result[Symbol].set(s);
+                }
+            }
+        }
+        return Result;
+    }
+    static constexpr ConstexprArray<Subset, EndSymbol + 1> Readers = readers();
+    static constexpr std::tuple<ConstexprArray<int, EndSymbol + 1>, ConstexprArray<int, EndSymbol + 1>, size_t> classes() {
+        ConstexprArray<int, EndSymbol + 1> Map;
+        ConstexprArray<int, EndSymbol + 1> Representatives;
+        size_t Count = 0;
+        for (int Symbol = 0; Symbol <= EndSymbol; ++Symbol) {
+            size_t c = 0;
+            for (; c < Count && !(Readers[Representatives[c]] == Readers[Symbol]); ++c);
+            if (c == Count) {
+                Representatives[Count++] = Symbol;
+            }
+            Map[Symbol] = c;
+        }
+        return std::make_tuple(Map, Representatives, Count);
+    }
+    static constexpr auto Classes = classes();
+    static constexpr size_t Columns = std::get<2>(Classes);
+    static constexpr size_t hash(const Subset &S) {
+        size_t Hash = 14695981039346656037ull;
+        for (size_t k = 0; k < S.Words.size(); ++k) {
+            Hash = (Hash ^ S.Words[k]) * 1099511628211ull;
+        }
+        return Hash;
+    }
+    // Returns the number of subsets, or Capacity + 1 if there are more. Table and
+    // Finals are filled in unless they are null. -1 is the empty subset.
+    template <size_t Capacity, size_t N>
+    static constexpr size_t explore(ConstexprArray<ConstexprArray<int, Columns>, N> *Table, ConstexprArray<bool, N> *Finals) {
+        ConstexprArray<Subset, Capacity> Subsets;
+        ConstexprArray<int, 2 * Capacity> Slots;
+        for (size_t i = 0; i < 2 * Capacity; ++i) {
+            Slots[i] = -1;
+        }
+        size_t Count = 0;
+        auto insert = [&](const Subset &S) {
+            size_t Slot = hash(S) % (2 * Capacity);
+            for (; Slots[Slot] != -1; Slot = (Slot + 1) % (2 * Capacity)) {
+                if (Subsets[Slots[Slot]] == S) {
+                    return static_cast<size_t>(Slots[Slot]);
+                }
+            }
+            if (Count == Capacity) {
+                return Capacity + 1;
+            }
+            Slots[Slot] = Count;
+            Subsets[Count] = S;
+            return Count++;
+        };
+        insert(Closures[0]);
+        for (size_t Id = 0; Id < Count; ++Id) {
+            if (Finals) {
+                (*Finals)[Id] = Subsets[Id][FinalState];
+            }
+            for (size_t c = 0; c < Columns; ++c) {
+                Subset Moving = Subsets[Id] & Readers[std::get<1>(Classes)[c]];
+                Subset Next;
+                for (size_t k = 0; k < Moving.Words.size(); ++k) {
+                    for (uint64_t Bits = Moving.Words[k]; Bits; Bits &= Bits - 1) {
+                        Next |= Closures[k * 64 + __builtin_ctzll(Bits) + 1];
+                    }
+                }
+                if (!Next.any()) {
+                    if (Table) {
+                        (*Table)[Id][c] = -1;
+                    }
+                    continue;
+                }
+                size_t NextId = insert(Next);
+                if (NextId == Capacity + 1) {
+                    return Capacity + 1;
+                }
+                if (Table) {
+                    (*Table)[Id][c] = NextId;
+                }
+            }
+        }
+        return Count;
+    }
+    template <size_t Capacity>
+    static constexpr size_t count() {
+        size_t Count = explore<Capacity, 1>(nullptr, nullptr);
+        if constexpr (Capacity < MaxCapacity) {
+            if (Count > Capacity) {
+                return count<std::min(4 * Capacity, MaxCapacity)>();
+            }
+        }
+        return Count;
+    }
+    static constexpr size_t States = count<std::min(std::max<size_t>(NFAStates, 16), MaxCapacity)>();
+    static_assert(States <= MaxCapacity, "the DFA has too many states, consider LazyDFAEngine");
+    static constexpr std::pair<ConstexprArray<ConstexprArray<int, Columns>, States>, ConstexprArray<bool, States>> build() {
+        ConstexprArray<ConstexprArray<int, Columns>, States> Table;
+        ConstexprArray<bool, States> Finals;
+        explore<States, States>(&Table, &Finals);
+        return std::make_pair(Table, Finals);
+    }
+    static constexpr auto Built = build();
+    struct FinalStates {
+        static constexpr size_t count() {
+            size_t Count = 0;
+            for (size_t i = 0; i < States; ++i) {
+                Count += Built.second[i];
+            }
+            return Count;
+        }
+        static constexpr size_t Size = count();
+        static constexpr ConstexprArray<int, Size> build() {
+            ConstexprArray<int, Size> Result;
+            for (size_t i = 0, k = 0; i < States; ++i) {
+                if (Built.second[i]) {
+                    Result[k++] = i;
+                }
+            }
+            return Result;
+        }
+        static constexpr ConstexprArray<int, Size> Array = build();
+    };
+    struct TransitionTable {
+        static constexpr ByteClassMap build_byte_classes() {
+            ByteClassMap Result;
+            for (int c = 0; c < 256; ++c) {
+                Result[c] = std::get<0>(Classes)[c];
+            }
+            return Result;
+        }
+        static constexpr ByteClassMap ByteClasses = build_byte_classes();
+        static constexpr int BeginClass = std::get<0>(Classes)[BeginSymbol];
+        static constexpr int EndClass = std::get<0>(Classes)[EndSymbol];
+        static constexpr auto Table = Built.first;
+    };
+    using Type = DFA<0, FinalStates, TransitionTable>;
+};
+
+template <typename R>
+using NFAToDFA = typename NFAToDFAImpl<R>::Type;
+
 template <typename DFA_>
 struct MinimizeDFAImpl {
     static constexpr int OldStates = DFA_::TransitionTable::Table.size();
+    static constexpr int Symbols = DFA_::TransitionTable::Table[0].size();
+    // Hopcroft partition refinement. States start out split into final and
+    // non-final blocks. A worklist holds pairs of a block and a symbol; each
+    // pair splits every block into the states that move into that block on
+    // that symbol and the others. Of the two halves of a split block only the
+    // smaller needs to go on the worklist, if the block was not on it already,
+    // so the work is O(Symbols * States * log(States)). The dead state (-1)
+    // takes part as an extra state OldStates, so live states that can never
+    // reach a final state collapse into it.
     static constexpr std::tuple<
         ConstexprArray<
-            ConstexprArray<int, SymbolsCount>,
+            ConstexprArray<int, Symbols>,
             OldStates
         >,                              // transition table
         int,                            // states count
@@ -433,110 +325,186 @@ struct MinimizeDFAImpl {
         >,                              // final states
         int                             // final states count
     > MinimizeTransitionTable() {
-        auto Table = DFA_::TransitionTable::Table;
-        int States = OldStates;
-        ConstexprArray<int, OldStates> StatesToMerge;
-        ConstexprArray<int, OldStates> OldNewStatesMap;
-        auto FinalStates = DFA_::FinalStates::Array;
-        int FinalStatesCount = FinalStates.size();
-        for (int i = 0; i < States; ) {
-            int StatesToMergeCount = 0;
-            bool IsIFinal = false;
-            for (int k = 0; k < FinalStatesCount; ++k) {
-                if (i == FinalStates[k]) {
-                    IsIFinal = true;
-                    break;
+        const auto &OldTable = DFA_::TransitionTable::Table;
+        constexpr int Dead = OldStates;
+        constexpr int N = OldStates + 1;
+        auto successor = [&](int i, int s) {
+            return (i == Dead || OldTable[i][s] == -1) ? Dead : OldTable[i][s];
+        };
+        // The states that move to t on s are Predecessors[PredecessorBegin[t * Symbols + s], ...[+ 1]).
+        ConstexprArray<int, N * Symbols + 1> PredecessorBegin;
+        ConstexprArray<int, N * Symbols> Predecessors;
+        for (int i = 0; i < N; ++i) {
+            for (int s = 0; s < Symbols; ++s) {
+                ++PredecessorBegin[successor(i, s) * Symbols + s + 1];
+            }
+        }
+        for (int k = 0; k < N * Symbols; ++k) {
+            PredecessorBegin[k + 1] += PredecessorBegin[k];
+        }
+        ConstexprArray<int, N * Symbols> Filled;
+        for (int i = 0; i < N; ++i) {
+            for (int s = 0; s < Symbols; ++s) {
+                int k = successor(i, s) * Symbols + s;
+                Predecessors[PredecessorBegin[k] + Filled[k]++] = i;
+            }
+        }
+        // Each block is a range [First, End) of Elements, and Location is where
+        // a state is in Elements.
+        ConstexprArray<int, N> Elements;
+        ConstexprArray<int, N> Location;
+        ConstexprArray<int, N> Block;
+        ConstexprArray<int, N> First;
+        ConstexprArray<int, N> End;
+        ConstexprArray<int, N> Marked;
+        ConstexprArray<bool, N> IsFinal;
+        for (size_t i = 0; i < DFA_::FinalStates::Size; ++i) {
+            IsFinal[DFA_::FinalStates::Array[i]] = true;
+        }
+        int Blocks = 0;
+        for (int Final = 1; Final >= 0; --Final) {
+            int Begin = Blocks == 0 ? 0 : End[0];
+            int Size = Begin;
+            for (int i = 0; i < N; ++i) {
+                if (IsFinal[i] == (Final == 1)) {
+                    Elements[Size] = i;
+                    Location[i] = Size;
+                    Block[i] = Blocks;
+                    ++Size;
                 }
             }
-            for (int j = i + 1; j < States; ++j) {
-                bool IsJFinal = false;
-                for (int k = 0; k < FinalStatesCount; ++k) {
-                    if (j == FinalStates[k]) {
-                        IsJFinal = true;
-                        break;
-                    }
+            if (Size != Begin) {
+                First[Blocks] = Begin;
+                End[Blocks] = Size;
+                ++Blocks;
+            }
+        }
+        ConstexprArray<bool, N * Symbols> Waiting;
+        ConstexprArray<int, N * Symbols> Worklist;
+        int Pending = 0;
+        if (Blocks == 2) {
+            int Smaller = End[0] - First[0] <= End[1] - First[1] ? 0 : 1;
+            for (int s = 0; s < Symbols; ++s) {
+                Worklist[Pending++] = Smaller * Symbols + s;
+                Waiting[Smaller * Symbols + s] = true;
+            }
+        }
+        ConstexprArray<int, N> Moving;
+        ConstexprArray<int, N> Touched;
+        while (Pending != 0) {
+            int Splitter = Worklist[--Pending];
+            Waiting[Splitter] = false;
+            int A = Splitter / Symbols;
+            int s = Splitter % Symbols;
+            // Collect the states that move into A on s, as marking them moves
+            // states around within A, then move them to the front of their blocks.
+            int Count = 0;
+            for (int k = First[A]; k < End[A]; ++k) {
+                int t = Elements[k] * Symbols + s;
+                for (int e = PredecessorBegin[t]; e < PredecessorBegin[t + 1]; ++e) {
+                    Moving[Count++] = Predecessors[e];
                 }
-                if (IsIFinal != IsJFinal) {
+            }
+            int TouchedCount = 0;
+            for (int j = 0; j < Count; ++j) {
+                int p = Moving[j];
+                int B = Block[p];
+                if (Marked[B] == 0) {
+                    Touched[TouchedCount++] = B;
+                }
+                int To = First[B] + Marked[B]++;
+                int Other = Elements[To];
+                Elements[Location[p]] = Other;
+                Location[Other] = Location[p];
+                Elements[To] = p;
+                Location[p] = To;
+            }
+            for (int j = 0; j < TouchedCount; ++j) {
+                int B = Touched[j];
+                int Split = First[B] + Marked[B];
+                Marked[B] = 0;
+                if (Split == End[B]) {
                     continue;
                 }
-                bool IsSame = true;
-                for (int s = 0; s < SymbolsCount; ++s) {
-                    if (Table[i][s] != Table[j][s]) {
-                        IsSame = false;
-                        break;
-                    }
+                int C = Blocks++;
+                First[C] = First[B];
+                End[C] = Split;
+                First[B] = Split;
+                for (int k = First[C]; k < End[C]; ++k) {
+                    Block[Elements[k]] = C;
                 }
-                if (!IsSame) {
-                    continue;
+                for (int c = 0; c < Symbols; ++c) {
+                    int Add = Waiting[B * Symbols + c] || End[C] - First[C] <= End[B] - First[B] ? C : B;
+                    if (!Waiting[Add * Symbols + c]) {
+                        Waiting[Add * Symbols + c] = true;
+                        Worklist[Pending++] = Add * Symbols + c;
+                    }
                 }
-                StatesToMerge[StatesToMergeCount] = j;
-                ++StatesToMergeCount;
             }
-            if (StatesToMergeCount == 0) {
-                ++i;
+        }
+        // Renumber the blocks so that the start state stays 0 and the dead block becomes -1.
+        ConstexprArray<int, OldStates + 1> BlockToState;
+        for (int i = 0; i <= Dead; ++i) {
+            BlockToState[i] = -2;
+        }
+        int States = 0;
+        for (int i = 0; i < OldStates; ++i) {
+            if (BlockToState[Block[i]] != -2) {
                 continue;
             }
-            int j = 0, k = 0, l = 0;
-            for (; j < States; ++j) {
-                for (; StatesToMerge[k] < j; ++k);
-                bool IsToMerge = StatesToMerge[k] == j;
-                if (IsToMerge) {
-                    OldNewStatesMap[j] = i;
-                    ++k;
-                } else {
-                    OldNewStatesMap[j] = l;
-                    ++l;
-                }
+            if (i != DFA_::StartState && Block[i] == Block[Dead]) {
+                BlockToState[Block[i]] = -1;
+            } else {
+                BlockToState[Block[i]] = States;
+                ++States;
             }
-            j = 0, k = 0, l = 0;
-            for (; j < States; ++j) {
-                for (; StatesToMerge[k] < j; ++k);
-                bool IsToMerge = StatesToMerge[k] == j;
-                if (IsToMerge) {
-                    ++k;
-                } else {
-                    for (int s = 0; s < SymbolsCount; ++s) {
-                        if (Table[j][s] == -1) {
-                            Table[l][s] = -1;
-                        } else {
-                            Table[l][s] = OldNewStatesMap[Table[j][s]];
-                        }
-                    }
-                    ++l;
-                }
+        }
+        if (BlockToState[Block[Dead]] == -2) {
+            BlockToState[Block[Dead]] = -1;
+        }
+        ConstexprArray<ConstexprArray<int, Symbols>, OldStates> Table;
+        for (int i = 0; i < OldStates; ++i) {
+            int State = BlockToState[Block[i]];
+            if (State == -1) {
+                continue;
             }
-            States = l;
-            j = 0; k = 0; l = 0;
-            for (; j < FinalStatesCount; ++j) {
-                for (; StatesToMerge[k] < FinalStates[j]; ++k);
-                bool IsToMerge = StatesToMerge[k] == FinalStates[j];
-                if (IsToMerge) {
-                    ++k;
-                } else {
-                    FinalStates[l] = OldNewStatesMap[FinalStates[j]];
-                    ++l;
-                }
+            for (int s = 0; s < Symbols; ++s) {
+                Table[State][s] = OldTable[i][s] == -1 ? -1 : BlockToState[Block[OldTable[i][s]]];
+            }
+        }
+        ConstexprArray<int, DFA_::FinalStates::Size> FinalStates;
+        int FinalStatesCount = 0;
+        for (size_t i = 0; i < DFA_::FinalStates::Size; ++i) {
+            int State = BlockToState[Block[DFA_::FinalStates::Array[i]]];
+            bool IsDuplicate = false;
+            for (int k = 0; k < FinalStatesCount; ++k) {
+                IsDuplicate = IsDuplicate || FinalStates[k] == State;
+            }
+            if (!IsDuplicate) {
+                FinalStates[FinalStatesCount] = State;
+                ++FinalStatesCount;
             }
-            FinalStatesCount = l;
-            i = 0;
         }
         return std::make_tuple(Table, States, FinalStates, FinalStatesCount);
     }
     static constexpr auto NewT = MinimizeTransitionTable();
-    struct FinalStatesTemp {
+    struct FinalStates {
+        static constexpr size_t Size = std::get<3>(NewT);
         static constexpr auto Array = TruncateArray<
-            std::get<3>(NewT),
+            Size,
             ConstexprArray<
                 int,
                 DFA_::FinalStates::Size
             >
         >(std::get<2>(NewT));
     };
-    using FinalStates = IntSet::FromArray<FinalStatesTemp>;
     struct TransitionTable {
+        static constexpr ByteClassMap ByteClasses = DFA_::TransitionTable::ByteClasses;
+        static constexpr int BeginClass = DFA_::TransitionTable::BeginClass;
+        static constexpr int EndClass = DFA_::TransitionTable::EndClass;
         static constexpr auto Table = TruncateArray<
             std::get<1>(NewT),
-            ConstexprArray<ConstexprArray<int, SymbolsCount>, OldStates>
+            ConstexprArray<ConstexprArray<int, Symbols>, OldStates>
         >(std::get<0>(NewT));
     };
     using Type = DFA<0, FinalStates, TransitionTable>;
@@ -545,60 +513,704 @@ struct MinimizeDFAImpl {
 template <typename DFA_>
 using MinimizeDFA = typename MinimizeDFAImpl<DFA_>::Type;
 
-template <char C>
-struct Char {
-    using NFA_ = SymbolNFA<C>;
-    using Set = IntSet::Set<C>;
-    static constexpr int Value = C;
-};
-
-struct Begin {
-    using NFA_ = SymbolNFA<BeginSymbol>;
-    using Set = IntSet::Set<BeginSymbol>;
-    static constexpr int Value = BeginSymbol;
-};
-
-struct End {
-    using NFA_ = SymbolNFA<EndSymbol>;
-    using Set = IntSet::Set<EndSymbol>;
-    static constexpr int Value = EndSymbol;
+// Merges the columns of the transition table that are identical in every state,
+// so that the table has one column per byte equivalence class instead of one per
+// symbol. Byte classes are numbered in the order of their smallest byte, which
+// keeps them below 256; Begin and End come last and may share a byte's column.
+template <typename DFA_>
+struct CompressDFAImpl {
+    using OldTransitionTable = typename DFA_::TransitionTable;
+    static constexpr int States = OldTransitionTable::Table.size();
+    static constexpr int OldColumns = OldTransitionTable::Table[0].size();
+    static constexpr int column_of(int symbol) {
+        if (symbol == BeginSymbol) {
+            return OldTransitionTable::BeginClass;
+        }
+        if (symbol == EndSymbol) {
+            return OldTransitionTable::EndClass;
+        }
+        return OldTransitionTable::ByteClasses[symbol];
+    }
+    static constexpr std::tuple<
+        ConstexprArray<int, OldColumns>,    // old column -> new column
+        ConstexprArray<int, OldColumns>,    // new column -> old column
+        int                                 // new columns count
+    > MergeColumns() {
+        const auto &Table = OldTransitionTable::Table;
+        ConstexprArray<int, OldColumns> OldToNew;
+        ConstexprArray<int, OldColumns> NewToOld;
+        int Columns = 0;
+        for (int c = 0; c < OldColumns; ++c) {
+            OldToNew[c] = -1;
+        }
+        for (int symbol = 0; symbol < EndSymbol + 1; ++symbol) {
+            int c = column_of(symbol);
+            if (OldToNew[c] != -1) {
+                continue;
+            }
+            int j = 0;
+            for (; j < Columns; ++j) {
+                bool IsSame = true;
+                for (int s = 0; s < States && IsSame; ++s) {
+                    IsSame = Table[s][c] == Table[s][NewToOld[j]];
+                }
+                if (IsSame) {
+                    break;
+                }
+            }
+            if (j == Columns) {
+                NewToOld[Columns] = c;
+                ++Columns;
+            }
+            OldToNew[c] = j;
+        }
+        return std::make_tuple(OldToNew, NewToOld, Columns);
+    }
+    static constexpr auto Merged = MergeColumns();
+    static constexpr int Columns = std::get<2>(Merged);
+    static constexpr ByteClassMap BuildByteClasses() {
+        ByteClassMap Result;
+        for (int i = 0; i < 256; ++i) {
+            Result[i] = std::get<0>(Merged)[column_of(i)];
+        }
+        return Result;
+    }
+    static constexpr ConstexprArray<ConstexprArray<int, Columns>, States> BuildTable() {
+        ConstexprArray<ConstexprArray<int, Columns>, States> Result;
+        for (int s = 0; s < States; ++s) {
+            for (int c = 0; c < Columns; ++c) {
+                Result[s][c] = OldTransitionTable::Table[s][std::get<1>(Merged)[c]];
+            }
+        }
+        return Result;
+    }
+    struct TransitionTable {
+        static constexpr ByteClassMap ByteClasses = BuildByteClasses();
+        static constexpr int BeginClass = std::get<0>(Merged)[column_of(BeginSymbol)];
+        static constexpr int EndClass = std::get<0>(Merged)[column_of(EndSymbol)];
+        static constexpr auto Table = BuildTable();
+    };
+    using Type = DFA<DFA_::StartState, typename DFA_::FinalStates, TransitionTable>;
 };
 
-struct Empty {
-    using NFA_ = EmptyNFA;
-};
+template <typename DFA_>
+using CompressDFA = typename CompressDFAImpl<DFA_>::Type;
 
-template <typename... Args>
-struct Union {
-    using NFA_ = UnionNFA<typename Args::NFA_...>;
-};
+// Dense tables of at least this many bytes are run from a comb vector instead,
+// if that saves a quarter of the space, see PackedDFA.
+constexpr size_t SparseTableBytes = 1 << 12;
 
-template <typename R>
-struct Star {
-    using NFA_ = StarNFA<typename R::NFA_>;
+// The form in which a DFA is executed. The table is a single flat array and a
+// state is identified by its row index premultiplied by the row stride, so each
+// transition is one indexed load. The element type is the narrowest unsigned type
+// that can hold every state id. Row 0 is the dead state, which loops to itself,
+// and the final states occupy the last rows, so a state is final iff its id is at
+// least FinalStates.
+//
+// Large DFAs mostly have rows that lead to one state, usually the dead one, for
+// all but a few bytes. Such a table is run sparse, by row displacement as in
+// Tarjan and Yao: each row keeps its most common target as a default and its
+// other transitions in the slots from its base on, rows sharing slots wherever
+// their transitions do not collide, and each slot holds the id of the state
+// that owns it. A state finds its base and default by its id shifted right,
+// not divided by Stride, so a transition is a shift, three loads and a select.
+// Table is built either way, for the analyses done at compile time; at run
+// time transitions go through transition(), so only the layout chosen ends up
+// in the binary.
+template <typename DFA_>
+struct PackedDFA {
+    using OldTransitionTable = typename DFA_::TransitionTable;
+    static constexpr size_t Stride = OldTransitionTable::Table[0].size();
+    static constexpr size_t States = OldTransitionTable::Table.size() + 1;
+    static constexpr size_t MaxState = (States - 1) * Stride;
+    using State = typename std::conditional<
+        MaxState <= UINT8_MAX,
+        uint8_t,
+        typename std::conditional<MaxState <= UINT16_MAX, uint16_t, uint32_t>::type
+    >::type;
+    static constexpr bool is_old_final(int state) {
+        for (size_t i = 0; i < DFA_::FinalStates::Array.size(); ++i) {
+            if (DFA_::FinalStates::Array[i] == state) {
+                return true;
+            }
+        }
+        return false;
+    }
+    static constexpr ConstexprArray<size_t, States - 1> BuildRows() {
+        ConstexprArray<size_t, States - 1> Rows;
+        size_t Row = 1;
+        for (size_t i = 0; i < States - 1; ++i) {
+            if (!is_old_final(i)) {
+                Rows[i] = Row;
+                ++Row;
+            }
+        }
+        for (size_t i = 0; i < States - 1; ++i) {
+            if (is_old_final(i)) {
+                Rows[i] = Row;
+                ++Row;
+            }
+        }
+        return Rows;
+    }
+    static constexpr ConstexprArray<size_t, States - 1> Rows = BuildRows();
+    static constexpr ConstexprArray<State, States * Stride> BuildTable() {
+        ConstexprArray<State, States * Stride> Result;
+        for (size_t i = 0; i < States - 1; ++i) {
+            for (size_t c = 0; c < Stride; ++c) {
+                int Next = OldTransitionTable::Table[i][c];
+                Result[Rows[i] * Stride + c] = Next == -1 ? 0 : Rows[Next] * Stride;
+            }
+        }
+        return Result;
+    }
+    static constexpr State DeadState = 0;
+    static constexpr State StartState = Rows[DFA_::StartState] * Stride;
+    static constexpr size_t FinalStates = (States - DFA_::FinalStates::Size) * Stride;
+    static constexpr ByteClassMap ByteClasses = OldTransitionTable::ByteClasses;
+    static constexpr size_t BeginClass = OldTransitionTable::BeginClass;
+    static constexpr size_t EndClass = OldTransitionTable::EndClass;
+    static constexpr ConstexprArray<State, States * Stride> Table = BuildTable();
+    // No row is placed past the rows before it, so a base fits in a state id.
+    struct SparseRow {
+        State Base = 0;
+        State Default = 0;
+    };
+    // Slots that no row owns belong to the dead state, which leads nowhere
+    // else, so reading them from it still gives the dead state.
+    struct SparseSlot {
+        State Owner = 0;
+        State Next = 0;
+    };
+    static constexpr size_t row_shift() {
+        size_t Shift = 0;
+        for (; (size_t(2) << Shift) <= Stride; ++Shift);
+        return Shift;
+    }
+    // 1 << RowShift is at most Stride, so ids shifted right by RowShift are
+    // still distinct, and SparseRows has fewer than twice States entries.
+    static constexpr size_t RowShift = row_shift();
+    static constexpr size_t RowSlots = (MaxState >> RowShift) + 1;
+    static constexpr bool Large = sizeof(Table) >= SparseTableBytes;
+    static constexpr size_t MaxSlots = Large ? States * Stride : 1;
+    struct Comb {
+        ConstexprArray<SparseRow, RowSlots> Rows;
+        ConstexprArray<SparseSlot, MaxSlots> Slots;
+        size_t Size = 0;
+    };
+    // The default of a row is the majority target if there is one, else the
+    // dead state. Rows are placed at the first base where they fit.
+    static constexpr Comb build_comb() {
+        Comb Result;
+        if constexpr (Large) {
+            size_t Free = 0;
+            for (size_t Row = 1; Row < States; ++Row) {
+                const size_t Offset = Row * Stride;
+                State Candidate = Table[Offset];
+                size_t Votes = 0;
+                for (size_t c = 0; c < Stride; ++c) {
+                    if (Votes == 0) {
+                        Candidate = Table[Offset + c];
+                    }
+                    Votes = Table[Offset + c] == Candidate ? Votes + 1 : Votes - 1;
+                }
+                size_t Count = 0;
+                for (size_t c = 0; c < Stride; ++c) {
+                    Count += Table[Offset + c] == Candidate;
+                }
+                State Default = 2 * Count > Stride ? Candidate : DeadState;
+                Result.Rows[Offset >> RowShift].Default = Default;
+                size_t First = 0;
+                for (; First < Stride && Table[Offset + First] == Default; ++First);
+                if (First == Stride) {
+                    continue;
+                }
+                size_t Base = Free > First ? Free - First : 0;
+                for (; ; ++Base) {
+                    size_t c = First;
+                    for (; c < Stride && (Table[Offset + c] == Default || Result.Slots[Base + c].Owner == 0); ++c);
+                    if (c == Stride) {
+                        break;
+                    }
+                }
+                Result.Rows[Offset >> RowShift].Base = static_cast<State>(Base);
+                for (size_t c = First; c < Stride; ++c) {
+                    if (Table[Offset + c] != Default) {
+                        Result.Slots[Base + c] = {static_cast<State>(Offset), Table[Offset + c]};
+                    }
+                }
+                Result.Size = std::max(Result.Size, Base + Stride);
+                for (; Free < Result.Size && Result.Slots[Free].Owner != 0; ++Free);
+            }
+        }
+        return Result;
+    }
+    static constexpr Comb Combed = build_comb();
+    static constexpr bool Sparse = Large && Combed.Size * sizeof(SparseSlot) + RowSlots * sizeof(SparseRow) <= sizeof(Table) / 4 * 3;
+    static constexpr ConstexprArray<SparseRow, RowSlots> SparseRows = Combed.Rows;
+    static constexpr auto SparseSlots = TruncateArray<Sparse ? Combed.Size : 1>(Combed.Slots);
+    static constexpr State transition(State state, size_t Column) {
+        if constexpr (Sparse) {
+            const SparseRow &Row = SparseRows[state >> RowShift];
+            const SparseSlot &Slot = SparseSlots[Row.Base + Column];
+            return Slot.Owner == state ? Slot.Next : Row.Default;
+        } else {
+            return Table[state + Column];
+        }
+    }
+    static constexpr State next(State state, unsigned char c) {
+        return transition(state, ByteClasses[c]);
+    }
+    static constexpr bool is_final(State state) {
+        return state >= FinalStates;
+    }
 };
 
 template <typename R>
-struct Plus {
-    using NFA_ = PlusNFA<typename R::NFA_>;
-};
+using CompileRegex = PackedDFA<CompressDFA<MinimizeDFA<NFAToDFA<R>>>>;
 
-template <typename R>
-struct Option {
-    using NFA_ = OptionNFA<typename R::NFA_>;
-};
+// Finds a byte string that every match of a PackedDFA contains, so that inputs
+// can be rejected, or skipped over, with a plain substring search before the DFA
+// runs. A state d whose only way forward is a chain of single bytes gives such a
+// literal when every path from the start states to acceptance passes through d.
+// Both the start state and the state after BeginSymbol count as start states.
+// IsPrefix is set when d is the start, i.e. every match begins with the literal.
+template <typename DFA_, size_t MaxLength = 32>
+struct RequiredLiteral {
+    using State = typename DFA_::State;
+    static constexpr State StartStates[2] = {
+        DFA_::StartState,
+        DFA_::transition(DFA_::StartState, DFA_::BeginClass)
+    };
+    static constexpr size_t byte_columns() {
+        size_t Columns = 0;
+        for (int c = 0; c < 256; ++c) {
+            if (DFA_::ByteClasses[c] >= Columns) {
+                Columns = DFA_::ByteClasses[c] + 1;
+            }
+        }
+        return Columns;
+    }
+    static constexpr size_t ByteColumns = byte_columns();
+    static constexpr bool is_accepting(State state) {
+        return DFA_::is_final(state) || DFA_::is_final(DFA_::transition(state, DFA_::EndClass));
+    }
+    // Returns the only byte that leads from state to a live state, or -1.
+    static constexpr int forced_byte(State state) {
+        if (is_accepting(state)) {
+            return -1;
+        }
+        int Byte = -1;
+        for (int c = 0; c < 256; ++c) {
+            if (DFA_::next(state, c) != DFA_::DeadState) {
+                if (Byte != -1) {
+                    return -1;
+                }
+                Byte = c;
+            }
+        }
+        return Byte;
+    }
+    // Returns whether an accepting state is reachable from start without passing
+    // through avoid.
+    static constexpr bool accepts(State start, State avoid) {
+        ConstexprArray<bool, DFA_::States> Visited;
+        ConstexprArray<State, DFA_::States> Queue;
+        size_t Head = 0, Tail = 0;
+        if (start != avoid && start != DFA_::DeadState) {
+            Visited[start / DFA_::Stride] = true;
+            Queue[Tail] = start;
+            ++Tail;
+        }
+        while (Head < Tail) {
+            State state = Queue[Head];
+            ++Head;
+            if (is_accepting(state)) {
+                return true;
+            }
+            for (size_t c = 0; c < ByteColumns; ++c) {
+                State Next = DFA_::transition(state, c);
+                if (Next != avoid && Next != DFA_::DeadState && !Visited[Next / DFA_::Stride]) {
+                    Visited[Next / DFA_::Stride] = true;
+                    Queue[Tail] = Next;
+                    ++Tail;
+                }
+            }
+        }
+        return false;
+    }
+    static constexpr bool dominates(State state) {
+        return !accepts(StartStates[0], state) && !accepts(StartStates[1], state);
+    }
+    static constexpr size_t chain(State state, ConstexprArray<char, MaxLength> &Out) {
+        size_t Length = 0;
+        for (int Byte = forced_byte(state); Byte != -1 && Length < MaxLength; Byte = forced_byte(state)) {
+            Out[Length] = Byte;
+            ++Length;
+            state = DFA_::next(state, Byte);
+        }
+        return Length;
+    }
+    static constexpr std::tuple<ConstexprArray<char, MaxLength>, size_t, bool> Find() {
+        // A prefix literal is preferred as it also tells where matches may begin.
+        // It is the common prefix of the chains of the start states that can accept.
+        ConstexprArray<char, MaxLength> Best;
+        size_t BestLength = MaxLength + 1;
+        for (State start : StartStates) {
+            if (!accepts(start, DFA_::DeadState)) {
+                continue;
+            }
+            ConstexprArray<char, MaxLength> Literal;
+            size_t Length = chain(start, Literal);
+            if (BestLength == MaxLength + 1) {
+                Best = Literal;
+                BestLength = Length;
+            }
+            size_t Common = 0;
+            for (; Common < Length && Common < BestLength && Literal[Common] == Best[Common]; ++Common);
+            BestLength = Common;
+        }
+        if (BestLength != 0 && BestLength != MaxLength + 1) {
+            return std::make_tuple(Best, BestLength, true);
+        }
+        BestLength = 0;
+        for (size_t i = 1; i < DFA_::States; ++i) {
+            State state = i * DFA_::Stride;
+            ConstexprArray<char, MaxLength> Literal;
+            size_t Length = chain(state, Literal);
+            if (Length > BestLength && dominates(state)) {
+                Best = Literal;
+                BestLength = Length;
+            }
+        }
+        return std::make_tuple(Best, BestLength, false);
+    }
+    static constexpr auto Found = Find();
+    static constexpr ConstexprArray<char, MaxLength> String = std::get<0>(Found);
+    static constexpr size_t Length = std::get<1>(Found);
+    static constexpr bool IsPrefix = std::get<2>(Found);
+};
+
+// Finds the strings of N bytes that every match starting past offset 0 begins
+// with, for the largest N <= MaxLength that keeps them at most MaxLiterals.
+// Count is 0 when there is no such N, e.g. when a match may be empty.
+template <typename DFA_, size_t MaxLiterals = 8, size_t MaxLength = 3>
+struct LeadingLiterals {
+    using State = typename DFA_::State;
+    using Literals = ConstexprArray<ConstexprArray<unsigned char, MaxLength>, MaxLiterals>;
+    // Returns how many strings of N bytes lead from the start state to a live
+    // state, or 0 if there are too many or a match ends before N bytes.
+    static constexpr size_t enumerate(size_t N, Literals &Out) {
+        ConstexprArray<State, MaxLiterals> Ends;
+        Ends[0] = DFA_::StartState;
+        size_t Count = 1;
+        for (size_t j = 0; j < N; ++j) {
+            Literals Next;
+            ConstexprArray<State, MaxLiterals> NextEnds;
+            size_t NextCount = 0;
+            for (size_t i = 0; i < Count; ++i) {
+                if (RequiredLiteral<DFA_>::is_accepting(Ends[i])) {
+                    return 0;
+                }
+                for (int c = 0; c < 256; ++c) {
+                    State state = DFA_::next(Ends[i], c);
+                    if (state == DFA_::DeadState) {
+                        continue;
+                    }
+                    if (NextCount == MaxLiterals) {
+                        return 0;
+                    }
+                    Next[NextCount] = Out[i];
+                    Next[NextCount][j] = c;
+                    NextEnds[NextCount] = state;
+                    ++NextCount;
+                }
+            }
+            Out = Next;
+            Ends = NextEnds;
+            Count = NextCount;
+        }
+        return Count;
+    }
+    static constexpr std::tuple<Literals, size_t, size_t> Find() {
+        for (size_t N = MaxLength; N > 0; --N) {
+            Literals Out;
+            size_t Count = enumerate(N, Out);
+            if (Count != 0) {
+                return std::make_tuple(Out, Count, N);
+            }
+        }
+        return std::make_tuple(Literals(), 0, 0);
+    }
+    static constexpr auto Found = Find();
+    static constexpr Literals Strings = std::get<0>(Found);
+    static constexpr size_t Count = std::get<1>(Found);
+    static constexpr size_t Length = std::get<2>(Found);
+};
+
+// Finds the next place past offset 0 where a match of a PackedDFA may begin. A
+// single leading literal is extended to the whole literal prefix and searched
+// for as a substring; a set of them is searched for with Teddy.
+template <typename DFA_>
+struct CandidateFinder {
+    using Leading = LeadingLiterals<DFA_>;
+    static constexpr bool Enabled = Leading::Count != 0;
+    static constexpr size_t FingerprintLength = Leading::Length == 0 ? 1 : Leading::Length;
+    static constexpr TeddyMasks<FingerprintLength> Masks =
+        BuildTeddyMasks<FingerprintLength>(Leading::Strings, Leading::Count);
+    static constexpr std::pair<ConstexprArray<char, 32>, size_t> prefix() {
+        ConstexprArray<char, 32> Out;
+        size_t Length = RequiredLiteral<DFA_, 32>::chain(DFA_::StartState, Out);
+        return std::make_pair(Out, Length);
+    }
+    static constexpr auto Prefix = prefix();
+    // Returns the first candidate at or after from, or npos.
+    static constexpr size_t find(const char *str, size_t length, size_t from) {
+        if constexpr (Leading::Count == 1) {
+            return std::string_view(str, length).find(
+                std::string_view(Prefix.first.data(), Prefix.second), from
+            );
+        } else {
+            return teddy_find(Masks, str, length, from);
+        }
+    }
+};
+
+// How a ProductDFA starts and accepts. Match starts from the components' states
+// after BeginSymbol and accepts where they would accept after EndSymbol, as
+// match does. Prefix starts from their start states and accepts in their final
+// states, as match_prefix does.
+enum class ProductMode {
+    Match,
+    Prefix
+};
+
+// Runs several PackedDFAs side by side as one DFA, with the same layout as a
+// PackedDFA but byte columns only. Its states are the tuples of component states
+// reachable from the start tuple, and each one records which components accept
+// there. The tuples are found by a breadth-first search that hashes them into
+// 2 * Capacity slots. It runs once to count them and once more to fill the table.
+template <size_t Capacity, ProductMode Mode, typename... DFAs>
+struct ProductDFA {
+    static constexpr size_t Components = sizeof...(DFAs);
+    using Tuple = ConstexprArray<uint32_t, Components>;
+    using Accepts = PatternMask<Components>;
+    static constexpr size_t FlatSize = (0 + ... + (DFAs::States * DFAs::Stride));
+    template <typename DFA_>
+    static constexpr void copy_table(ConstexprArray<uint32_t, FlatSize> &Out, size_t Base) {
+        for (size_t i = 0; i < DFA_::States * DFA_::Stride; ++i) {
+            Out[Base + i] = DFA_::Table[i];
+        }
+    }
+    static constexpr ConstexprArray<uint32_t, FlatSize> flatten() {
+        ConstexprArray<uint32_t, FlatSize> Result;
+        size_t Base = 0;
+        ((copy_table<DFAs>(Result, Base), Base += DFAs::States * DFAs::Stride), ...);
+        return Result;
+    }
+    static constexpr ConstexprArray<size_t, Components> bases() {
+        size_t Sizes[] = {DFAs::States * DFAs::Stride...};
+        ConstexprArray<size_t, Components> Result;
+        size_t Base = 0;
+        for (size_t i = 0; i < Components; ++i) {
+            Result[i] = Base;
+            Base += Sizes[i];
+        }
+        return Result;
+    }
+    // The component tables one after another, starting at Bases.
+    static constexpr ConstexprArray<uint32_t, FlatSize> Flat = flatten();
+    static constexpr ConstexprArray<size_t, Components> Bases = bases();
+    static constexpr ConstexprArray<ByteClassMap, Components> ComponentClasses = {DFAs::ByteClasses...};
+    static constexpr ConstexprArray<size_t, Components> EndClasses = {DFAs::EndClass...};
+    static constexpr ConstexprArray<size_t, Components> ComponentFinals = {DFAs::FinalStates...};
+    static constexpr Tuple StartTuple = Mode == ProductMode::Match ?
+        Tuple{static_cast<uint32_t>(DFAs::transition(DFAs::StartState, DFAs::BeginClass))...} :
+        Tuple{static_cast<uint32_t>(DFAs::StartState)...};
+    // Bytes are in the same class iff they are in the same class in every component.
+    static constexpr std::tuple<ByteClassMap, ByteClassMap, size_t> combine_classes() {
+        ByteClassMap Map;
+        ByteClassMap Representatives;
+        size_t Count = 0;
+        for (int b = 0; b < 256; ++b) {
+            size_t c = 0;
+            for (; c < Count; ++c) {
+                bool Same = true;
+                for (size_t i = 0; i < Components && Same; ++i) {
+                    Same = ComponentClasses[i][b] == ComponentClasses[i][Representatives[c]];
+                }
+                if (Same) {
+                    break;
+                }
+            }
+            if (c == Count) {
+                Representatives[Count] = b;
+                ++Count;
+            }
+            Map[b] = c;
+        }
+        return std::make_tuple(Map, Representatives, Count);
+    }
+    static constexpr auto Combined = combine_classes();
+    static constexpr ByteClassMap ByteClasses = std::get<0>(Combined);
+    static constexpr ByteClassMap Representatives = std::get<1>(Combined);
+    static constexpr size_t Stride = std::get<2>(Combined);
+    static constexpr size_t hash(const Tuple &T) {
+        size_t Hash = 14695981039346656037ull;
+        for (size_t i = 0; i < Components; ++i) {
+            Hash = (Hash ^ T[i]) * 1099511628211ull;
+        }
+        return Hash % (2 * Capacity);
+    }
+    // Returns the number of states, or Capacity + 1 if there are more. Table and
+    // Finals are filled in unless they are null.
+    template <size_t N>
+    static constexpr size_t explore(ConstexprArray<uint32_t, N * Stride> *Table, ConstexprArray<Accepts, N> *Finals) {
+        ConstexprArray<Tuple, Capacity> Tuples;
+        ConstexprArray<int, 2 * Capacity> Slots;
+        for (size_t i = 0; i < 2 * Capacity; ++i) {
+            Slots[i] = -1;
+        }
+        size_t Count = 0;
+        auto insert = [&](const Tuple &T) {
+            size_t Slot = hash(T);
+            for (; Slots[Slot] != -1; Slot = (Slot + 1) % (2 * Capacity)) {
+                bool Same = true;
+                for (size_t i = 0; i < Components && Same; ++i) {
+                    Same = Tuples[Slots[Slot]][i] == T[i];
+                }
+                if (Same) {
+                    return static_cast<size_t>(Slots[Slot]);
+                }
+            }
+            if (Count == Capacity) {
+                return Capacity + 1;
+            }
+            Slots[Slot] = Count;
+            Tuples[Count] = T;
+            return Count++;
+        };
+        insert(Tuple());
+        insert(StartTuple);
+        for (size_t Id = 0; Id < Count; ++Id) {
+            Tuple T = Tuples[Id];
+            if (Finals) {
+                for (size_t i = 0; i < Components; ++i) {
+                    uint32_t Last = Mode == ProductMode::Match ? Flat[Bases[i] + T[i] + EndClasses[i]] : T[i];
+                    if (Last >= ComponentFinals[i]) {
+                        (*Finals)[Id].set(i);
+                    }
+                }
+            }
+            for (size_t c = 0; c < Stride; ++c) {
+                Tuple Next;
+                for (size_t i = 0; i < Components; ++i) {
+                    Next[i] = Flat[Bases[i] + T[i] + ComponentClasses[i][Representatives[c]]];
+                }
+                size_t NextId = insert(Next);
+                if (NextId == Capacity + 1) {
+                    return Capacity + 1;
+                }
+                if (Table) {
+                    (*Table)[Id * Stride + c] = NextId * Stride;
+                }
+            }
+        }
+        return Count;
+    }
+    static constexpr size_t States = explore<1>(nullptr, nullptr);
+    static_assert(States <= Capacity, "the product DFA has too many states");
+    static constexpr size_t MaxState = (States - 1) * Stride;
+    using State = typename std::conditional<
+        MaxState <= UINT8_MAX,
+        uint8_t,
+        typename std::conditional<MaxState <= UINT16_MAX, uint16_t, uint32_t>::type
+    >::type;
+    static constexpr std::pair<ConstexprArray<State, States * Stride>, ConstexprArray<Accepts, States>> build() {
+        ConstexprArray<uint32_t, States * Stride> Wide;
+        ConstexprArray<Accepts, States> Finals;
+        explore<States>(&Wide, &Finals);
+        ConstexprArray<State, States * Stride> Result;
+        for (size_t i = 0; i < States * Stride; ++i) {
+            Result[i] = Wide[i];
+        }
+        return std::make_pair(Result, Finals);
+    }
+    static constexpr auto Built = build();
+    static constexpr State DeadState = 0;
+    static constexpr bool is_dead(const Tuple &T) {
+        for (size_t i = 0; i < Components; ++i) {
+            if (T[i] != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+    // The dead tuple is explored first and the start tuple second.
+    static constexpr State StartState = is_dead(StartTuple) ? 0 : Stride;
+    static constexpr ConstexprArray<State, States * Stride> Table = Built.first;
+    static constexpr ConstexprArray<Accepts, States> Finals = Built.second;
+    static constexpr State next(State state, unsigned char c) {
+        return Table[state + ByteClasses[c]];
+    }
+};
+
+// Symbols are bytes, so chars above 127 are stored as 128 to 255, not as the
+// negative values a signed char gives them.
+template <char C>
+struct Char {
+    using Reversed = Char;
+    static constexpr int Value = static_cast<unsigned char>(C);
+    using Set = IntSet::Set<Value>;
+};
+
+struct Begin {
+    using Reversed = Begin;
+    using Set = IntSet::Set<BeginSymbol>;
+    static constexpr int Value = BeginSymbol;
+};
+
+struct End {
+    using Reversed = End;
+    using Set = IntSet::Set<EndSymbol>;
+    static constexpr int Value = EndSymbol;
+};
+
+struct Empty {
+    using Reversed = Empty;
+};
+
+template <typename... Args>
+struct Union {
+    using Reversed = Union<typename Args::Reversed...>;
+};
+
+template <typename R>
+struct Star {
+    using Reversed = Star<typename R::Reversed>;
+};
+
+template <typename R>
+struct Plus {
+    using Reversed = Plus<typename R::Reversed>;
+};
+
+template <typename R>
+struct Option {
+    using Reversed = Option<typename R::Reversed>;
+};
 
 template <typename... Args>
 struct Concat;
 
 template <typename Head, typename... Rest>
 struct Concat<Head, Rest...> {
-    using NFA_ = ConcatNFA<typename Head::NFA_, typename Concat<Rest...>::NFA_>;
+    using Reversed = Concat<typename Concat<Rest...>::Reversed, typename Head::Reversed>;
 };
 
 template <typename Head>
 struct Concat<Head> {
-    using NFA_ = typename Head::NFA_;;
+    using Reversed = typename Head::Reversed;
 };
 
 template <typename R, int... N>
@@ -606,58 +1218,59 @@ struct Repeat;
 
 template <typename R, int N>
 struct Repeat<R, N> {
-    using NFA_ = ConcatNFA<typename R::NFA_, typename Repeat<R, N - 1>::NFA_>;
+    using Reversed = Repeat<typename R::Reversed, N>;
 };
 
 template <typename R>
 struct Repeat<R, 1> {
-    using NFA_ = typename R::NFA_;
+    using Reversed = typename R::Reversed;
 };
 
 template <typename R>
 struct Repeat<R, 0> {
-    using NFA_ = EmptyNFA;
+    using Reversed = Empty;
 };
 
 template <typename R, int N1, int N2>
 struct Repeat<R, N1, N2> {
-    using NFA_ = ConcatNFA<typename Repeat<R, N1>::NFA_, typename Repeat<Option<R>, N2 - N1>::NFA_>;
+    using Reversed = Repeat<typename R::Reversed, N1, N2>;
 };
 
 template <typename R, int N>
 using AtLeast = Concat<Repeat<R, N>, Star<R>>;
 
+// The set is sorted, as the set operations merge sorted arrays.
 template <char... Args>
 struct CharClass {
-    using NFA_ = CharClassNFA<Args...>;
-    using Set = IntSet::Set<Args...>;
+    using Set = IntSet::Union<IntSet::Set<>, IntSet::Set<static_cast<unsigned char>(Args)>...>;
+    using Reversed = CharClass;
 };
 
 template <unsigned char C1, unsigned char C2>
 struct Range {
-    using NFA_ = CharClassFromSetNFA<IntSet::Range<C1, C2 + 1>>;
-    using Set = IntSet::Range<C1, C2 + 1>;
+    using Set = IntSet::Range<C1, C2>;
+    using Reversed = Range;
 };
 
 template <typename... Args>
 struct CharClassUnion {
     using Set = IntSet::Union<typename Args::Set...>;
-    using NFA_ = CharClassFromSetNFA<Set>;
+    using Reversed = CharClassUnion;
 };
 
 template <typename Set_>
 struct CharClassFromSet {
     using Set = Set_;
-    using NFA_ = CharClassFromSetNFA<Set>;
+    using Reversed = CharClassFromSet;
 };
 
 template <typename C>
 struct CharClassComplement {
     using Set = IntSet::Diff<
-        IntSet::Range<0, SymbolsCount>,
+        IntSet::Range<0, 255>,
         typename C::Set
     >;
-    using NFA_ = CharClassFromSetNFA<Set>;
+    using Reversed = CharClassComplement;
 };
 
 using Any = Range<0, 255>;
@@ -666,95 +1279,2176 @@ using LowerCase = Range<'a', 'z'>;
 using UpperCase = Range<'A', 'Z'>;
 using Letter = CharClassUnion<LowerCase, UpperCase>;
 
-template <typename R>
-class Regex {
-private:
-    using NFA_ = typename R::NFA_;
-    using DFA_ = NFAToDFA<NFA_>;
-    using MinimalDFA = DFA_;
-    static constexpr bool is_final(int state) {
-        for (size_t i = 0; i < MinimalDFA::FinalStates::Array.size(); ++i) {
-            if (MinimalDFA::FinalStates::Array[i] == state) {
-                return true;
-            }
-        }
-        return false;
-    }
-public:
-    static bool match(const std::string &str) {
-        int state = MinimalDFA::StartState;
-        state = MinimalDFA::TransitionTable::Table[state][BeginSymbol];
-        for (char c : str) {
-            if (state == -1) {
-                return false;
-            }
-            state = MinimalDFA::TransitionTable::Table[state][c];
-        }
-        if (state == -1) {
-            return false;
-        }
-        state = MinimalDFA::TransitionTable::Table[state][EndSymbol];
-        return is_final(state);
-    }
-    static constexpr bool match(const char *str, size_t length) {
-        int state = MinimalDFA::StartState;
-        state = MinimalDFA::TransitionTable::Table[state][BeginSymbol];
-        for (size_t i = 0; i < length; ++i) {
-            if (state == -1) {
-                return false;
-            }
-            state = MinimalDFA::TransitionTable::Table[state][str[i]];
-        }
-        if (state == -1) {
-            return false;
-        }
-        state = MinimalDFA::TransitionTable::Table[state][EndSymbol];
-        return is_final(state);
-    }
-    static constexpr bool match(const char *str) {
-        int state = MinimalDFA::StartState;
-        state = MinimalDFA::TransitionTable::Table[state][BeginSymbol];
-        for (size_t i = 0; str[i]; ++i) {
-            if (state == -1) {
-                return false;
-            }
-            state = MinimalDFA::TransitionTable::Table[state][str[i]];
-        }
-        if (state == -1) {
-            return false;
-        }
-        state = MinimalDFA::TransitionTable::Table[state][EndSymbol];
-        return is_final(state);
+// The UTF-8 encoding of one code point of a class. The class is expanded to a
+// union of sequences of byte ranges, see utf8.hpp, so the DFA still takes one
+// step per byte. URange<0x4E00, 0x9FFF> matches a CJK ideograph and
+// UProperty<unicode_property("Greek")> a Greek letter, as \p{Greek} does.
+template <typename Source>
+struct Utf8ClassImpl {
+    static constexpr Utf8Sequences<MaxUtf8Sequences> Sequences = Source::sequences();
+    template <size_t I, typename Index = std::make_index_sequence<Sequences.Items[I].Length>>
+    struct Sequence;
+    template <size_t I, size_t... K>
+    struct Sequence<I, std::index_sequence<K...>> {
+        using Type = Concat<Range<Sequences.Items[I].Low[K], Sequences.Items[I].High[K]>...>;
+    };
+    template <typename Index>
+    struct Build;
+    template <size_t... I>
+    struct Build<std::index_sequence<I...>> {
+        using Type = Union<typename Sequence<I>::Type...>;
+    };
+    using Type = typename Build<std::make_index_sequence<Sequences.Size>>::Type;
+};
+
+template <uint32_t From, uint32_t To>
+struct URangeSource {
+    static constexpr Utf8Sequences<MaxUtf8Sequences> sequences() {
+        CodePointRange Range = {From, To};
+        return utf8_sequences(&Range, 1);
     }
-    static size_t match_prefix(const std::string &str) {
-        int state = MinimalDFA::StartState;
-        for (size_t i = 0; i < str.length(); ++i) {
-            if (state == -1) {
-                return i;
-            }
-            state = MinimalDFA::TransitionTable::Table[state][str[i]];
-        }
-        return str.length();
+};
+
+template <size_t Index>
+struct UPropertySource {
+    static_assert(Index < UnicodePropertiesCount, "Unknown Unicode property");
+    static constexpr Utf8Sequences<MaxUtf8Sequences> sequences() {
+        return utf8_sequences(UnicodeProperties[Index].Ranges, UnicodeProperties[Index].Count);
     }
-    static constexpr size_t match_prefix(const char *str, size_t length) {
-        int state = MinimalDFA::StartState;
-        for (size_t i = 0; i < length; ++i) {
-            if (state == -1) {
-                return i;
-            }
-            state = MinimalDFA::TransitionTable::Table[state][str[i]];
+};
+
+template <uint32_t From, uint32_t To>
+using URange = typename Utf8ClassImpl<URangeSource<From, To>>::Type;
+
+template <size_t Index>
+using UProperty = typename Utf8ClassImpl<UPropertySource<Index>>::Type;
+
+// ICase<R> matches R regardless of ASCII case. Every symbol set of R is folded,
+// so a letter of either case reads both and the DFA gets it for free. A
+// complement is taken of the folded class, so [^a] excludes both a and A. Bytes
+// above 127, and so UTF-8 classes, are left alone.
+constexpr int other_case(int c) {
+    return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+template <typename S>
+struct FoldCaseSet {
+    static constexpr std::pair<size_t, ConstexprArray<int, SymbolsCount>> fold() {
+        ConstexprArray<bool, SymbolsCount> Member;
+        for (size_t i = 0; i < S::Size; ++i) {
+            Member[S::Array[i]] = true;
+            Member[other_case(S::Array[i])] = true;
         }
-        return length;
-    }
-    static constexpr size_t match_prefix(const char *str) {
-        int state = MinimalDFA::StartState;
-        size_t i = 0;
-        for (; str[i]; ++i) {
-            if (state == -1) {
-                return i;
+        std::pair<size_t, ConstexprArray<int, SymbolsCount>> Result;
+        for (int c = 0; c < SymbolsCount; ++c) {
+            if (Member[c]) {
+                Result.second[Result.first++] = c;
             }
-            state = MinimalDFA::TransitionTable::Table[state][str[i]];
         }
-        return i;
+        return Result;
     }
-};
\ No newline at end of file
+    static constexpr std::pair<size_t, ConstexprArray<int, SymbolsCount>> Folded = fold();
+    template <typename Index>
+    struct ArrayToSet;
+    template <size_t... I>
+    struct ArrayToSet<std::index_sequence<I...>> {
+        using Type = IntSet::Set<Folded.second[I]...>;
+    };
+    using Type = typename ArrayToSet<std::make_index_sequence<Folded.first>>::Type;
+};
+
+// Any node with a Set becomes the class of its folded set.
+template <typename R>
+struct ICaseImpl {
+    using Type = CharClassFromSet<typename FoldCaseSet<typename R::Set>::Type>;
+};
+
+template <typename R>
+using ICase = typename ICaseImpl<R>::Type;
+
+template <>
+struct ICaseImpl<Begin> {
+    using Type = Begin;
+};
+
+template <>
+struct ICaseImpl<End> {
+    using Type = End;
+};
+
+template <>
+struct ICaseImpl<Empty> {
+    using Type = Empty;
+};
+
+template <typename C>
+struct ICaseImpl<CharClassComplement<C>> {
+    using Type = CharClassComplement<ICase<C>>;
+};
+
+template <typename... Args>
+struct ICaseImpl<Union<Args...>> {
+    using Type = Union<ICase<Args>...>;
+};
+
+template <typename... Args>
+struct ICaseImpl<Concat<Args...>> {
+    using Type = Concat<ICase<Args>...>;
+};
+
+template <typename R>
+struct ICaseImpl<Star<R>> {
+    using Type = Star<ICase<R>>;
+};
+
+template <typename R>
+struct ICaseImpl<Plus<R>> {
+    using Type = Plus<ICase<R>>;
+};
+
+template <typename R>
+struct ICaseImpl<Option<R>> {
+    using Type = Option<ICase<R>>;
+};
+
+template <typename R, int... N>
+struct ICaseImpl<Repeat<R, N...>> {
+    using Type = Repeat<ICase<R>, N...>;
+};
+
+// Prefixes<R> matches every prefix of a match of R, or a bit more: repeats
+// are widened to stars, which keeps the automaton small. Any node with a Set,
+// Begin and End included, reads its symbol or nothing.
+template <typename R>
+struct PrefixesImpl {
+    using Type = Option<R>;
+};
+
+template <typename R>
+using Prefixes = typename PrefixesImpl<R>::Type;
+
+template <>
+struct PrefixesImpl<Empty> {
+    using Type = Empty;
+};
+
+template <typename... Args>
+struct PrefixesImpl<Union<Args...>> {
+    using Type = Union<Prefixes<Args>...>;
+};
+
+template <typename Head, typename... Rest>
+struct PrefixesImpl<Concat<Head, Rest...>> {
+    using Type = Union<Prefixes<Head>, Concat<Head, Prefixes<Concat<Rest...>>>>;
+};
+
+template <typename Head>
+struct PrefixesImpl<Concat<Head>> {
+    using Type = Prefixes<Head>;
+};
+
+template <typename R>
+struct PrefixesImpl<Star<R>> {
+    using Type = Concat<Star<R>, Prefixes<R>>;
+};
+
+template <typename R>
+struct PrefixesImpl<Plus<R>> {
+    using Type = Concat<Star<R>, Prefixes<R>>;
+};
+
+template <typename R>
+struct PrefixesImpl<Option<R>> {
+    using Type = Prefixes<R>;
+};
+
+template <typename R, int... N>
+struct PrefixesImpl<Repeat<R, N...>> {
+    using Type = Concat<Star<R>, Prefixes<R>>;
+};
+
+// A run of Min to Max symbols of the class C, read by a single position with a
+// counter rather than by Max unrolled copies of C. Only CountingEngine counts
+// it, after CountRuns<R> has put it in place of every Repeat of a class in R.
+template <typename C, int Min, int Max>
+struct CountedRun {
+    using Reversed = CountedRun;
+};
+
+template <typename R, typename = void>
+struct IsSymbolClass : std::false_type {};
+
+template <typename R>
+struct IsSymbolClass<R, std::void_t<typename R::Set>>
+    : std::bool_constant<!std::is_same<R, Begin>::value && !std::is_same<R, End>::value> {};
+
+template <typename R>
+struct CountRunsImpl {
+    using Type = R;
+};
+
+template <typename R>
+using CountRuns = typename CountRunsImpl<R>::Type;
+
+template <typename... Args>
+struct CountRunsImpl<Union<Args...>> {
+    using Type = Union<CountRuns<Args>...>;
+};
+
+template <typename... Args>
+struct CountRunsImpl<Concat<Args...>> {
+    using Type = Concat<CountRuns<Args>...>;
+};
+
+template <typename R>
+struct CountRunsImpl<Star<R>> {
+    using Type = Star<CountRuns<R>>;
+};
+
+template <typename R>
+struct CountRunsImpl<Plus<R>> {
+    using Type = Plus<CountRuns<R>>;
+};
+
+template <typename R>
+struct CountRunsImpl<Option<R>> {
+    using Type = Option<CountRuns<R>>;
+};
+
+template <typename R, int N>
+struct CountRunsImpl<Repeat<R, N>> {
+    using Type = std::conditional_t<
+        IsSymbolClass<R>::value && (N > 1), CountedRun<R, N, N>, Repeat<CountRuns<R>, N>
+    >;
+};
+
+template <typename R, int N1, int N2>
+struct CountRunsImpl<Repeat<R, N1, N2>> {
+    using Type = std::conditional_t<
+        IsSymbolClass<R>::value && (N2 > 1), CountedRun<R, N1, N2>, Repeat<CountRuns<R>, N1, N2>
+    >;
+};
+
+// Position (Glushkov) automaton of a regex, with one state per occurrence of a
+// symbol class. GlushkovImpl<R>::build numbers the positions of R from Offset,
+// records the symbols each one reads and which may follow which, and returns the
+// positions a match may start and end with. Any node with a Set is a single
+// position.
+template <size_t N>
+struct GlushkovSets {
+    PatternMask<N> First;
+    PatternMask<N> Last;
+    bool Nullable;
+};
+
+struct GlushkovCounter {
+    size_t Min = 0;
+    size_t Max = 0;
+};
+
+template <size_t N>
+struct GlushkovTables {
+    static constexpr size_t Positions = N;
+    ConstexprArray<PatternMask<N>, SymbolsCount> Symbols;
+    ConstexprArray<PatternMask<N>, N> Follow;
+    // The bounds of the positions of CountedRun nodes; Max is 0 for the others.
+    ConstexprArray<GlushkovCounter, N> Counters;
+};
+
+template <size_t N>
+constexpr void glushkov_follow(GlushkovTables<N> &Tables, const PatternMask<N> &From, const PatternMask<N> &To) {
+    for (size_t k = 0; k < From.Words.size(); ++k) {
+        for (uint64_t Bits = From.Words[k]; Bits; Bits &= Bits - 1) {
+            Tables.Follow[k * 64 + __builtin_ctzll(Bits)] |= To;
+        }
+    }
+}
+
+template <typename R>
+struct GlushkovImpl {
+    static constexpr size_t Positions = 1;
+    template <size_t N>
+    static constexpr GlushkovSets<N> build(GlushkovTables<N> &Tables, size_t Offset) {
+        PatternMask<N> Position;
+        Position.set(Offset);
+        for (size_t i = 0; i < R::Set::Size; ++i) {
+            Tables.Symbols[R::Set::Array[i]].set(Offset);
+        }
+        return {Position, Position, false};
+    }
+};
+
+template <>
+struct GlushkovImpl<Empty> {
+    static constexpr size_t Positions = 0;
+    template <size_t N>
+    static constexpr GlushkovSets<N> build(GlushkovTables<N> &, size_t) {
+        return {{}, {}, true};
+    }
+};
+
+template <typename Head, typename... Rest>
+struct GlushkovImpl<Union<Head, Rest...>> {
+    using Left = GlushkovImpl<Head>;
+    using Right = GlushkovImpl<Union<Rest...>>;
+    static constexpr size_t Positions = Left::Positions + Right::Positions;
+    template <size_t N>
+    static constexpr GlushkovSets<N> build(GlushkovTables<N> &Tables, size_t Offset) {
+        GlushkovSets<N> L = Left::build(Tables, Offset);
+        GlushkovSets<N> R = Right::build(Tables, Offset + Left::Positions);
+        return {L.First | R.First, L.Last | R.Last, L.Nullable || R.Nullable};
+    }
+};
+
+template <>
+struct GlushkovImpl<Union<>> {
+    static constexpr size_t Positions = 0;
+    template <size_t N>
+    static constexpr GlushkovSets<N> build(GlushkovTables<N> &, size_t) {
+        return {{}, {}, false};
+    }
+};
+
+template <typename Head, typename... Rest>
+struct GlushkovImpl<Concat<Head, Rest...>> {
+    using Left = GlushkovImpl<Head>;
+    using Right = GlushkovImpl<Concat<Rest...>>;
+    static constexpr size_t Positions = Left::Positions + Right::Positions;
+    template <size_t N>
+    static constexpr GlushkovSets<N> build(GlushkovTables<N> &Tables, size_t Offset) {
+        GlushkovSets<N> L = Left::build(Tables, Offset);
+        GlushkovSets<N> R = Right::build(Tables, Offset + Left::Positions);
+        glushkov_follow(Tables, L.Last, R.First);
+        return {
+            L.Nullable ? L.First | R.First : L.First,
+            R.Nullable ? L.Last | R.Last : R.Last,
+            L.Nullable && R.Nullable
+        };
+    }
+};
+
+template <typename Head>
+struct GlushkovImpl<Concat<Head>> : GlushkovImpl<Head> {};
+
+template <typename R>
+struct GlushkovImpl<Star<R>> {
+    static constexpr size_t Positions = GlushkovImpl<R>::Positions;
+    template <size_t N>
+    static constexpr GlushkovSets<N> build(GlushkovTables<N> &Tables, size_t Offset) {
+        GlushkovSets<N> Sets = GlushkovImpl<R>::build(Tables, Offset);
+        glushkov_follow(Tables, Sets.Last, Sets.First);
+        return {Sets.First, Sets.Last, true};
+    }
+};
+
+template <typename R>
+struct GlushkovImpl<Plus<R>> {
+    static constexpr size_t Positions = GlushkovImpl<R>::Positions;
+    template <size_t N>
+    static constexpr GlushkovSets<N> build(GlushkovTables<N> &Tables, size_t Offset) {
+        GlushkovSets<N> Sets = GlushkovImpl<R>::build(Tables, Offset);
+        glushkov_follow(Tables, Sets.Last, Sets.First);
+        return Sets;
+    }
+};
+
+template <typename R>
+struct GlushkovImpl<Option<R>> {
+    static constexpr size_t Positions = GlushkovImpl<R>::Positions;
+    template <size_t N>
+    static constexpr GlushkovSets<N> build(GlushkovTables<N> &Tables, size_t Offset) {
+        GlushkovSets<N> Sets = GlushkovImpl<R>::build(Tables, Offset);
+        return {Sets.First, Sets.Last, true};
+    }
+};
+
+template <typename R, int N>
+struct GlushkovImpl<Repeat<R, N>> : GlushkovImpl<Concat<R, Repeat<R, N - 1>>> {};
+
+template <typename R>
+struct GlushkovImpl<Repeat<R, 1>> : GlushkovImpl<R> {};
+
+template <typename R>
+struct GlushkovImpl<Repeat<R, 0>> : GlushkovImpl<Empty> {};
+
+template <typename R, int N1, int N2>
+struct GlushkovImpl<Repeat<R, N1, N2>> : GlushkovImpl<Concat<Repeat<R, N1>, Repeat<Option<R>, N2 - N1>>> {};
+
+// The run is one position that reads C, without a follow edge to itself: going
+// round belongs to its counter, and an edge to itself from an enclosing loop
+// starts another run.
+template <typename C, int Min, int Max>
+struct GlushkovImpl<CountedRun<C, Min, Max>> {
+    static constexpr size_t Positions = 1;
+    template <size_t N>
+    static constexpr GlushkovSets<N> build(GlushkovTables<N> &Tables, size_t Offset) {
+        GlushkovSets<N> Sets = GlushkovImpl<C>::build(Tables, Offset);
+        Tables.Counters[Offset] = {Min, Max};
+        return {Sets.First, Sets.Last, Min == 0};
+    }
+};
+
+// Any node with a Set reads it from its first state into its second.
+template <typename R>
+struct ThompsonImpl {
+    static constexpr size_t States = 2;
+    template <size_t N>
+    static constexpr void build(ThompsonNFA<N> &NFA_, size_t Offset) {
+        for (size_t i = 0; i < R::Set::Size; ++i) {
+            NFA_.Symbols[Offset].set(R::Set::Array[i]);
+        }
+    }
+};
+
+template <>
+struct ThompsonImpl<Empty> {
+    static constexpr size_t States = 1;
+    template <size_t N>
+    static constexpr void build(ThompsonNFA<N> &, size_t) {}
+};
+
+template <typename Head, typename... Rest>
+struct ThompsonImpl<Union<Head, Rest...>> {
+    using Left = ThompsonImpl<Head>;
+    using Right = ThompsonImpl<Union<Rest...>>;
+    static constexpr size_t States = Left::States + Right::States + 2;
+    template <size_t N>
+    static constexpr void build(ThompsonNFA<N> &NFA_, size_t Offset) {
+        size_t Final = Offset + States - 1;
+        Left::build(NFA_, Offset + 1);
+        Right::build(NFA_, Offset + 1 + Left::States);
+        NFA_.epsilon(Offset, Offset + 1);
+        NFA_.epsilon(Offset, Offset + 1 + Left::States);
+        NFA_.epsilon(Offset + Left::States, Final);
+        NFA_.epsilon(Final - 1, Final);
+    }
+};
+
+template <typename Head>
+struct ThompsonImpl<Union<Head>> : ThompsonImpl<Head> {};
+
+template <>
+struct ThompsonImpl<Union<>> {
+    static constexpr size_t States = 2;
+    template <size_t N>
+    static constexpr void build(ThompsonNFA<N> &, size_t) {}
+};
+
+template <typename Head, typename... Rest>
+struct ThompsonImpl<Concat<Head, Rest...>> {
+    using Left = ThompsonImpl<Head>;
+    using Right = ThompsonImpl<Concat<Rest...>>;
+    static constexpr size_t States = Left::States + Right::States;
+    template <size_t N>
+    static constexpr void build(ThompsonNFA<N> &NFA_, size_t Offset) {
+        Left::build(NFA_, Offset);
+        Right::build(NFA_, Offset + Left::States);
+        NFA_.epsilon(Offset + Left::States - 1, Offset + Left::States);
+    }
+};
+
+template <typename Head>
+struct ThompsonImpl<Concat<Head>> : ThompsonImpl<Head> {};
+
+template <typename R>
+struct ThompsonImpl<Star<R>> {
+    static constexpr size_t States = ThompsonImpl<R>::States + 2;
+    template <size_t N>
+    static constexpr void build(ThompsonNFA<N> &NFA_, size_t Offset) {
+        size_t Final = Offset + States - 1;
+        ThompsonImpl<R>::build(NFA_, Offset + 1);
+        NFA_.epsilon(Offset, Offset + 1);
+        NFA_.epsilon(Offset, Final);
+        NFA_.epsilon(Final - 1, Offset + 1);
+        NFA_.epsilon(Final - 1, Final);
+    }
+};
+
+template <typename R>
+struct ThompsonImpl<Plus<R>> {
+    static constexpr size_t States = ThompsonImpl<R>::States + 1;
+    template <size_t N>
+    static constexpr void build(ThompsonNFA<N> &NFA_, size_t Offset) {
+        size_t Final = Offset + States - 1;
+        ThompsonImpl<R>::build(NFA_, Offset);
+        NFA_.epsilon(Final - 1, Offset);
+        NFA_.epsilon(Final - 1, Final);
+    }
+};
+
+template <typename R>
+struct ThompsonImpl<Option<R>> {
+    static constexpr size_t States = ThompsonImpl<R>::States + 2;
+    template <size_t N>
+    static constexpr void build(ThompsonNFA<N> &NFA_, size_t Offset) {
+        size_t Final = Offset + States - 1;
+        ThompsonImpl<R>::build(NFA_, Offset + 1);
+        NFA_.epsilon(Offset, Offset + 1);
+        NFA_.epsilon(Offset, Final);
+        NFA_.epsilon(Final - 1, Final);
+    }
+};
+
+template <typename R, int N>
+struct ThompsonImpl<Repeat<R, N>> : ThompsonImpl<Concat<R, Repeat<R, N - 1>>> {};
+
+template <typename R>
+struct ThompsonImpl<Repeat<R, 1>> : ThompsonImpl<R> {};
+
+template <typename R>
+struct ThompsonImpl<Repeat<R, 0>> : ThompsonImpl<Empty> {};
+
+template <typename R, int N1, int N2>
+struct ThompsonImpl<Repeat<R, N1, N2>> : ThompsonImpl<Concat<Repeat<R, N1>, Repeat<Option<R>, N2 - N1>>> {};
+
+// Engines for Regex. DFAEngine runs the DFA built by subset construction and
+// supports the whole API. BitParallelEngine simulates the position automaton
+// instead, which needs no subset construction, for match and match_prefix of
+// patterns with at most 64 positions. LazyDFAEngine builds the DFA of the
+// position automaton at run time instead, only the states the input reaches,
+// for match, match_prefix and search of patterns whose DFA is too large to
+// build at compile time. It keeps at most CacheStates of them per thread.
+// DirectCodedEngine runs the same DFA as DFAEngine for match and match_prefix,
+// but as code: each state is a loop over the bytes that keep it there, which
+// jumps to the code of the next state on any other byte. That beats the table
+// on long runs in one state, as in identifiers, and loses to it where the
+// input takes a different path through the states every time.
+// CountingEngine simulates the position automaton as BitParallelEngine does,
+// but reads every bounded Repeat of a symbol class with one counted position,
+// so that compile time and tables stay the same whatever the bounds, for
+// match, match_prefix and search of patterns with large counts.
+struct DFAEngine {};
+struct BitParallelEngine {};
+template <size_t CacheStates = 1024>
+struct LazyDFAEngine {};
+struct DirectCodedEngine {};
+struct CountingEngine {};
+
+struct MatchSpan {
+    constexpr MatchSpan() : begin(0), end(0), matched(false) {}
+    constexpr MatchSpan(size_t begin_, size_t end_) : begin(begin_), end(end_), matched(true) {}
+    size_t begin;
+    size_t end;
+    bool matched;
+    constexpr explicit operator bool() const {
+        return matched;
+    }
+};
+
+// Binary buffers may be given as unsigned char or std::byte. They are read
+// through char, which may alias any object, so nothing is copied, and every
+// engine widens each char to unsigned char before it looks the byte up, so all
+// 256 values match as themselves. The overloads taking them are not constexpr,
+// as the cast is not allowed there.
+template <typename B>
+using ByteInput = std::enable_if_t<std::is_same<B, unsigned char>::value || std::is_same<B, std::byte>::value>;
+
+template <typename B, typename = ByteInput<B>>
+inline const char *byte_chars(const B *data) {
+    return reinterpret_cast<const char *>(data);
+}
+
+template <typename R, typename Engine = DFAEngine>
+class Regex {
+private:
+    using DFA_ = CompileRegex<R>;
+    using State = typename DFA_::State;
+    // Automata for unanchored search. Each is a class of its own rather than an
+    // alias, so only the ones that search, match_prefix or find use are built.
+    // Begin and End are made optional around R, so feeding BeginSymbol at
+    // offset 0 and EndSymbol at the end of the input works whether or not R
+    // itself contains them.
+    struct SearchDFA {
+        // Whether a match may consume BeginSymbol right at its start.
+        static constexpr bool BeginMatters = DFA_::transition(DFA_::StartState, DFA_::BeginClass) != DFA_::DeadState;
+        // A byte that no match begins with. Reading it from the start leaves
+        // Forward in the state it is in when the search starts past offset 0.
+        static constexpr int idle_byte() {
+            for (int c = 0; c < 256; ++c) {
+                if (DFA_::next(DFA_::StartState, c) == DFA_::DeadState) {
+                    return c;
+                }
+            }
+            return 0;
+        }
+        // Matches any input that ends with a match of R.
+        struct Forward : CompileRegex<Concat<Option<Begin>, Star<Any>, R>> {
+            static constexpr typename Forward::State Idle = Forward::next(Forward::StartState, idle_byte());
+        };
+        // Run backwards from the end of a match to find where it starts.
+        struct Reverse : CompileRegex<Concat<Option<End>, typename R::Reversed, Option<Begin>>> {};
+        // Run forwards from the start of a match to find its longest end.
+        struct Anchored : CompileRegex<Concat<Option<Begin>, R, Option<End>>> {};
+        // Run backwards from the end of a match to find the earliest begin of
+        // a longer match that may still be under way there.
+        struct Prefix : CompileRegex<Concat<typename Prefixes<R>::Reversed, Option<Begin>>> {};
+    };
+    static constexpr size_t length_of(const char *str) {
+        size_t i = 0;
+        for (; str[i]; ++i);
+        return i;
+    }
+    // Returns the end of the match in str[from, length) that ends first, or -1.
+    // Whenever Forward is back in its idle state, it continues as if the search
+    // started afresh, so it jumps ahead to the next candidate.
+    static constexpr ssize_t find_end(const char *str, size_t length, size_t from) {
+        using Forward = typename SearchDFA::Forward;
+        using Candidates = CandidateFinder<DFA_>;
+        typename Forward::State state = Forward::StartState;
+        if (from == 0) {
+            state = Forward::transition(state, Forward::BeginClass);
+        }
+        if constexpr (Candidates::Enabled) {
+            if (from != 0 || !SearchDFA::BeginMatters) {
+                state = Forward::Idle;
+            }
+        }
+        for (size_t i = from; i < length; ++i) {
+            if (Forward::is_final(state)) {
+                return i;
+            }
+            if (state == Forward::DeadState) {
+                return -1;
+            }
+            if constexpr (Candidates::Enabled) {
+                if (state == Forward::Idle) {
+                    size_t next = Candidates::find(str, length, i);
+                    if (next == std::string_view::npos) {
+                        return -1;
+                    }
+                    i = next;
+                }
+            }
+            state = Forward::next(state, str[i]);
+        }
+        if (Forward::is_final(state) || Forward::is_final(Forward::transition(state, Forward::EndClass))) {
+            return length;
+        }
+        return -1;
+    }
+    // Returns the smallest begin >= from such that str[begin, end) is a match.
+    static constexpr size_t find_begin(const char *str, size_t length, size_t from, size_t end) {
+        using Reverse = typename SearchDFA::Reverse;
+        typename Reverse::State state = Reverse::StartState;
+        if (end == length) {
+            state = Reverse::transition(state, Reverse::EndClass);
+        }
+        size_t begin = end;
+        for (size_t i = end; ; --i) {
+            if (Reverse::is_final(state)) {
+                begin = i;
+            }
+            if (i == 0 && Reverse::is_final(Reverse::transition(state, Reverse::BeginClass))) {
+                begin = 0;
+            }
+            if (i == from || state == Reverse::DeadState) {
+                break;
+            }
+            state = Reverse::next(state, str[i - 1]);
+        }
+        return begin;
+    }
+    // Returns the smallest begin >= from such that str[begin, end) is a prefix
+    // of a match, as far as Prefix tells.
+    static constexpr size_t find_prefix_begin(const char *str, size_t from, size_t end) {
+        using Prefix = typename SearchDFA::Prefix;
+        typename Prefix::State state = Prefix::StartState;
+        size_t begin = end;
+        for (size_t i = end; ; --i) {
+            if (Prefix::is_final(state) || (i == 0 && Prefix::is_final(Prefix::transition(state, Prefix::BeginClass)))) {
+                begin = i;
+            }
+            if (i == from || state == Prefix::DeadState) {
+                break;
+            }
+            state = Prefix::next(state, str[i - 1]);
+        }
+        return begin;
+    }
+    // Returns the end of the longest match starting at begin, which must be at least end.
+    static constexpr size_t find_longest(const char *str, size_t length, size_t begin, size_t end) {
+        using Anchored = typename SearchDFA::Anchored;
+        typename Anchored::State state = Anchored::StartState;
+        if (begin == 0) {
+            state = Anchored::transition(state, Anchored::BeginClass);
+        }
+        for (size_t i = begin; i < length; ++i) {
+            if (Anchored::is_final(state)) {
+                end = i;
+            }
+            if (state == Anchored::DeadState) {
+                return end;
+            }
+            state = Anchored::next(state, str[i]);
+        }
+        if (Anchored::is_final(state) || Anchored::is_final(Anchored::transition(state, Anchored::EndClass))) {
+            end = length;
+        }
+        return end;
+    }
+    // Returns the leftmost match in str[from, length) that begins at most at
+    // last, extended to its longest end. Anchored is walked from every begin at
+    // once, keeping one walk per state, the one that began first, since walks
+    // in the same state end in the same places. Once a match is found, walks
+    // that began after it are dropped and no new ones are started.
+    static constexpr MatchSpan find_leftmost(const char *str, size_t length, size_t from, size_t last) {
+        using Anchored = typename SearchDFA::Anchored;
+        ConstexprArray<typename Anchored::State, Anchored::States> states;
+        ConstexprArray<size_t, Anchored::States> begins;
+        // One past the offset at which each state was last kept.
+        ConstexprArray<size_t, Anchored::States> kept;
+        size_t count = 0;
+        MatchSpan span;
+        for (size_t i = from; ; ++i) {
+            if (i <= last && !span) {
+                typename Anchored::State state = Anchored::StartState;
+                if (i == 0) {
+                    state = Anchored::transition(state, Anchored::BeginClass);
+                }
+                if (kept[state / Anchored::Stride] != i + 1) {
+                    kept[state / Anchored::Stride] = i + 1;
+                    states[count] = state;
+                    begins[count++] = i;
+                }
+            }
+            // Walks are in order of begin, so the first accepting one is leftmost.
+            for (size_t k = 0; k < count; ++k) {
+                if (Anchored::is_final(states[k]) ||
+                    (i == length && Anchored::is_final(Anchored::transition(states[k], Anchored::EndClass)))) {
+                    span = MatchSpan(begins[k], i);
+                    count = k + 1;
+                    break;
+                }
+            }
+            if (i == length || (count == 0 && (span || i >= last))) {
+                return span;
+            }
+            size_t alive = 0;
+            for (size_t k = 0; k < count; ++k) {
+                typename Anchored::State next = Anchored::next(states[k], str[i]);
+                if (next != Anchored::DeadState && kept[next / Anchored::Stride] != i + 2) {
+                    kept[next / Anchored::Stride] = i + 2;
+                    states[alive] = next;
+                    begins[alive++] = begins[k];
+                }
+            }
+            count = alive;
+        }
+    }
+    // Moves from to the first place where a match may begin, judged by the
+    // literal every match contains, or returns -1 if the input lacks it. The
+    // substring search is memchr-based at run time.
+    static constexpr ssize_t skip_to_literal(const char *str, size_t length, size_t from) {
+        using Literal = RequiredLiteral<DFA_>;
+        if constexpr (Literal::Length == 0) {
+            return from;
+        } else {
+            size_t position = std::string_view(str, length).find(
+                std::string_view(Literal::String.data(), Literal::Length), from
+            );
+            if (position == std::string_view::npos) {
+                return -1;
+            }
+            return Literal::IsPrefix ? position : from;
+        }
+    }
+    // Matches the inputs from next on that are too short for match_batch to walk
+    // in lockstep, and returns the index of the first one that is not.
+    template <typename Out>
+    static constexpr size_t match_short(const std::string_view *inputs, size_t count, Out *out, size_t next) {
+        for (; next < count && inputs[next].size() < BatchMinLength; ++next) {
+            out[next] = match(inputs[next].data(), inputs[next].size());
+        }
+        return next;
+    }
+    static constexpr MatchSpan find_from(const char *str, size_t length, size_t from) {
+        ssize_t skipped = skip_to_literal(str, length, from);
+        if (skipped == -1) {
+            return MatchSpan();
+        }
+        from = skipped;
+        ssize_t end = find_end(str, length, from);
+        if (end == -1) {
+            return MatchSpan();
+        }
+        // A match that begins before begin ends after end, so it is under way
+        // at end. It is looked for only from where one may be.
+        size_t begin = find_begin(str, length, from, end);
+        size_t first = begin == from || static_cast<size_t>(end) == length ? begin : find_prefix_begin(str, from, end);
+        if (first == begin) {
+            return MatchSpan(begin, find_longest(str, length, begin, end));
+        }
+        return find_leftmost(str, length, first, begin);
+    }
+public:
+    static bool match(const std::string &str) {
+        return match(str.data(), str.length());
+    }
+    static constexpr bool match(const char *str, size_t length) {
+        State state = DFA_::transition(DFA_::StartState, DFA_::BeginClass);
+        for (size_t i = 0; i < length; ++i) {
+            if (state == DFA_::DeadState) {
+                return false;
+            }
+            state = DFA_::next(state, str[i]);
+        }
+        state = DFA_::transition(state, DFA_::EndClass);
+        return DFA_::is_final(state);
+    }
+    static constexpr bool match(const char *str) {
+        State state = DFA_::transition(DFA_::StartState, DFA_::BeginClass);
+        for (size_t i = 0; str[i]; ++i) {
+            if (state == DFA_::DeadState) {
+                return false;
+            }
+            state = DFA_::next(state, str[i]);
+        }
+        state = DFA_::transition(state, DFA_::EndClass);
+        return DFA_::is_final(state);
+    }
+    // Sets out[i] to whether inputs[i] matches, for i < count. BatchLanes inputs
+    // are walked in lockstep, so that their table loads overlap instead of
+    // forming one chain of dependent loads. Each round runs until the shortest
+    // lane ends, and finished lanes take the next input. The dead state loops to
+    // itself, so no lane needs to stop early. Inputs shorter than BatchMinLength
+    // are matched on their own: below it, refilling lanes every few steps costs
+    // more than the overlap gains, which on Decimal is 1.0x to 1.3x at 64
+    // bytes and 1.3x to 1.5x at 200 bytes.
+    // Both buffers belong to the caller and nothing refers to them after the
+    // call. out is written while inputs are read, so it must not overlap them
+    // or the bytes they view. Its elements may be of any type bool converts to,
+    // e.g. char where std::vector<bool> has no buffer to point to.
+    static constexpr size_t BatchLanes = 8;
+    static constexpr size_t BatchMinLength = 64;
+    template <typename Out>
+    static constexpr void match_batch_n(const std::string_view *inputs, size_t count, Out *out) {
+        State states[BatchLanes] = {};
+        const char *data[BatchLanes] = {};
+        size_t left[BatchLanes] = {};
+        size_t index[BatchLanes] = {};
+        size_t next = match_short(inputs, count, out, 0);
+        for (size_t k = 0; k < BatchLanes; ++k) {
+            if (next == count) {
+                for (size_t j = 0; j < k; ++j) {
+                    out[index[j]] = match(data[j], left[j]);
+                }
+                return;
+            }
+            states[k] = DFA_::transition(DFA_::StartState, DFA_::BeginClass);
+            data[k] = inputs[next].data();
+            left[k] = inputs[next].size();
+            index[k] = next;
+            next = match_short(inputs, count, out, next + 1);
+        }
+        for (;;) {
+            size_t steps = left[0];
+            for (size_t k = 1; k < BatchLanes; ++k) {
+                steps = std::min(steps, left[k]);
+            }
+            for (size_t i = 0; i < steps; ++i) {
+                for (size_t k = 0; k < BatchLanes; ++k) {
+                    states[k] = DFA_::next(states[k], data[k][i]);
+                }
+            }
+            for (size_t k = 0; k < BatchLanes; ++k) {
+                data[k] += steps;
+                left[k] -= steps;
+            }
+            for (size_t k = 0; k < BatchLanes; ++k) {
+                if (left[k] != 0) {
+                    continue;
+                }
+                out[index[k]] = DFA_::is_final(DFA_::transition(states[k], DFA_::EndClass));
+                if (next == count) {
+                    // Finish the other lanes one by one.
+                    for (size_t j = 0; j < BatchLanes; ++j) {
+                        if (j == k) {
+                            continue;
+                        }
+                        State state = states[j];
+                        for (size_t i = 0; i < left[j] && state != DFA_::DeadState; ++i) {
+                            state = DFA_::next(state, data[j][i]);
+                        }
+                        out[index[j]] = DFA_::is_final(DFA_::transition(state, DFA_::EndClass));
+                    }
+                    return;
+                }
+                states[k] = DFA_::transition(DFA_::StartState, DFA_::BeginClass);
+                data[k] = inputs[next].data();
+                left[k] = inputs[next].size();
+                index[k] = next;
+                next = match_short(inputs, count, out, next + 1);
+            }
+        }
+    }
+    // match_batch_n over contiguous ranges, such as std::vector, std::array or
+    // arrays, of std::string_view and of the results. Only as many inputs as
+    // both ranges hold are matched, so a short out is never overrun, and their
+    // number is returned.
+    template <typename Inputs, typename Outputs>
+    static constexpr size_t match_batch(const Inputs &inputs, Outputs &&out) {
+        static_assert(std::is_convertible<decltype(std::data(inputs)), const std::string_view *>::value,
+                      "match_batch reads a contiguous range of std::string_view");
+        size_t count = std::min<size_t>(std::size(inputs), std::size(out));
+        match_batch_n(std::data(inputs), count, std::data(out));
+        return count;
+    }
+    // Returns whether any substring of str matches. BeginSymbol only matches at
+    // the start of str and EndSymbol only at its end.
+    static bool search(const std::string &str) {
+        return search(str.data(), str.length());
+    }
+    static constexpr bool search(const char *str, size_t length) {
+        ssize_t from = skip_to_literal(str, length, 0);
+        return from != -1 && find_end(str, length, from) != -1;
+    }
+    static constexpr bool search(const char *str) {
+        return search(str, length_of(str));
+    }
+    // Returns the span of the leftmost-longest match in str: the match that
+    // begins first, extended to its longest end. A forward pass finds where the
+    // first match ends and a backward pass where it begins. If a longer match
+    // may begin earlier, the bytes from there are walked again from every begin.
+    static MatchSpan find(const std::string &str) {
+        return find(str.data(), str.length());
+    }
+    static constexpr MatchSpan find(const char *str, size_t length) {
+        return find_from(str, length, 0);
+    }
+    static constexpr MatchSpan find(const char *str) {
+        return find(str, length_of(str));
+    }
+    // Iterates over the non-overlapping matches in a buffer, as find would
+    // report them one after another. After an empty match the search resumes
+    // one byte further on. The iterator only refers to the buffer, which must
+    // outlive it.
+    class MatchIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::string_view *;
+        using reference = const std::string_view &;
+        constexpr MatchIterator() : input_(), match_(), matched_(false) {}
+        constexpr explicit MatchIterator(std::string_view input) :
+            input_(input),
+            match_(),
+            matched_(false) {
+            find_next(0);
+        }
+        constexpr reference operator*() const {
+            return match_;
+        }
+        constexpr pointer operator->() const {
+            return &match_;
+        }
+        constexpr MatchIterator &operator++() {
+            size_t end = match_.data() - input_.data() + match_.size();
+            if (match_.empty()) {
+                ++end;
+            }
+            find_next(end);
+            return *this;
+        }
+        constexpr MatchIterator operator++(int) {
+            MatchIterator old = *this;
+            ++*this;
+            return old;
+        }
+        constexpr bool operator==(const MatchIterator &other) const {
+            if (!matched_ || !other.matched_) {
+                return matched_ == other.matched_;
+            }
+            return match_.data() == other.match_.data() && match_.size() == other.match_.size();
+        }
+        constexpr bool operator!=(const MatchIterator &other) const {
+            return !(*this == other);
+        }
+    private:
+        constexpr void find_next(size_t from) {
+            MatchSpan span;
+            if (from <= input_.size()) {
+                span = find_from(input_.data(), input_.size(), from);
+            }
+            matched_ = span.matched;
+            match_ = matched_ ? input_.substr(span.begin, span.end - span.begin) : std::string_view();
+        }
+        std::string_view input_;
+        std::string_view match_;
+        bool matched_;
+    };
+    class MatchRange {
+    public:
+        constexpr explicit MatchRange(std::string_view input) : input_(input) {}
+        constexpr MatchIterator begin() const {
+            return MatchIterator(input_);
+        }
+        constexpr MatchIterator end() const {
+            return MatchIterator();
+        }
+    private:
+        std::string_view input_;
+    };
+    static constexpr MatchRange find_all(std::string_view input) {
+        return MatchRange(input);
+    }
+    // Matches input that arrives in chunks, carrying the DFA state across them,
+    // so nothing is copied or buffered. finish() feeds EndSymbol and returns
+    // whether the whole stream matches, as match would. The overloads taking a
+    // callback also run the search automaton and call it once with the stream
+    // offset of every place where a match of R ends, for the matches that begin
+    // where the first chunk fed with a callback does or later.
+    class Stream {
+    public:
+        constexpr Stream() :
+            state_(DFA_::transition(DFA_::StartState, DFA_::BeginClass)),
+            search_(NotSearching),
+            offset_(0) {}
+        constexpr void feed(const char *str, size_t length) {
+            for (size_t i = 0; i < length && state_ != DFA_::DeadState; ++i) {
+                state_ = DFA_::next(state_, str[i]);
+            }
+            offset_ += length;
+        }
+        template <typename F>
+        constexpr void feed(const char *str, size_t length, F &&on_match) {
+            using Forward = typename SearchDFA::Forward;
+            typename Forward::State search = start_search(on_match);
+            for (size_t i = 0; i < length; ++i) {
+                state_ = DFA_::next(state_, str[i]);
+                search = Forward::next(search, str[i]);
+                if (Forward::is_final(search)) {
+                    on_match(offset_ + i + 1);
+                }
+            }
+            search_ = search;
+            offset_ += length;
+        }
+        template <typename B, typename = ByteInput<B>>
+        void feed(const B *data, size_t length) {
+            feed(byte_chars(data), length);
+        }
+        template <typename B, typename F, typename = ByteInput<B>>
+        void feed(const B *data, size_t length, F &&on_match) {
+            feed(byte_chars(data), length, std::forward<F>(on_match));
+        }
+        constexpr bool finish() const {
+            return DFA_::is_final(DFA_::transition(state_, DFA_::EndClass));
+        }
+        template <typename F>
+        constexpr bool finish(F &&on_match) {
+            using Forward = typename SearchDFA::Forward;
+            typename Forward::State search = start_search(on_match);
+            if (!Forward::is_final(search) && Forward::is_final(Forward::transition(search, Forward::EndClass))) {
+                on_match(offset_);
+            }
+            return finish();
+        }
+        // The number of bytes fed so far.
+        constexpr size_t offset() const {
+            return offset_;
+        }
+    private:
+        static constexpr uint32_t NotSearching = UINT32_MAX;
+        // Returns the search state, starting the search here if it has not
+        // started yet.
+        template <typename F>
+        constexpr typename SearchDFA::Forward::State start_search(F &on_match) {
+            using Forward = typename SearchDFA::Forward;
+            if (search_ == NotSearching) {
+                search_ = Forward::StartState;
+                if (offset_ == 0) {
+                    search_ = Forward::transition(search_, Forward::BeginClass);
+                }
+                // An empty match ends where the search starts.
+                if (Forward::is_final(search_)) {
+                    on_match(offset_);
+                }
+            }
+            return search_;
+        }
+        State state_;
+        // Wide enough for the state of any search automaton.
+        uint32_t search_;
+        size_t offset_;
+    };
+private:
+    // Returns the length of the longest prefix of str that matches, or of the
+    // shortest if First, or npos if none does. BeginSymbol is fed first and
+    // EndSymbol after the whole of str, so anchors in R work, and the walk stops
+    // as soon as the DFA dies.
+    template <bool First>
+    static constexpr size_t prefix(const char *str, size_t length) {
+        using Anchored = typename SearchDFA::Anchored;
+        typename Anchored::State state = Anchored::transition(Anchored::StartState, Anchored::BeginClass);
+        size_t end = std::string_view::npos;
+        size_t i = 0;
+        for (; ; ++i) {
+            if (Anchored::is_final(state)) {
+                end = i;
+                if (First) {
+                    return end;
+                }
+            }
+            if (i == length || state == Anchored::DeadState) {
+                break;
+            }
+            state = Anchored::next(state, str[i]);
+        }
+        if (i == length && end != length && Anchored::is_final(Anchored::transition(state, Anchored::EndClass))) {
+            end = length;
+        }
+        return end;
+    }
+public:
+    // Returns the length of the longest prefix of str that matches, or
+    // std::string_view::npos if none does, so an empty match is told apart.
+    static size_t match_prefix(const std::string &str) {
+        return match_prefix(str.data(), str.length());
+    }
+    static constexpr size_t match_prefix(const char *str, size_t length) {
+        return prefix<false>(str, length);
+    }
+    static constexpr size_t match_prefix(const char *str) {
+        return match_prefix(str, length_of(str));
+    }
+    // Returns the length of the shortest prefix of str that matches, or npos.
+    // It reads no further than that, which is all a validation needs.
+    static size_t first_accept(const std::string &str) {
+        return first_accept(str.data(), str.length());
+    }
+    static constexpr size_t first_accept(const char *str, size_t length) {
+        return prefix<true>(str, length);
+    }
+    static constexpr size_t first_accept(const char *str) {
+        return first_accept(str, length_of(str));
+    }
+    // The same over binary buffers, see ByteInput.
+    template <typename B, typename = ByteInput<B>>
+    static bool match(const B *data, size_t length) {
+        return match(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static bool search(const B *data, size_t length) {
+        return search(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static MatchSpan find(const B *data, size_t length) {
+        return find(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static size_t match_prefix(const B *data, size_t length) {
+        return match_prefix(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static size_t first_accept(const B *data, size_t length) {
+        return first_accept(byte_chars(data), length);
+    }
+};
+
+template <typename R>
+class Regex<R, BitParallelEngine> {
+private:
+    using Impl = GlushkovImpl<R>;
+    static_assert(Impl::Positions <= 64, "BitParallelEngine supports at most 64 positions");
+    static constexpr size_t Chunks = Impl::Positions == 0 ? 1 : (Impl::Positions + 7) / 8;
+    struct Automaton {
+        // The positions that read each symbol.
+        ConstexprArray<uint64_t, SymbolsCount> Symbols;
+        // The positions that may follow any of the positions in a byte of the
+        // state, indexed by the byte's number and value.
+        ConstexprArray<ConstexprArray<uint64_t, 256>, Chunks> Follow;
+        uint64_t First = 0;
+        uint64_t Last = 0;
+        bool Nullable = false;
+    };
+    static constexpr Automaton build() {
+        GlushkovTables<Chunks * 8> Tables;
+        GlushkovSets<Chunks * 8> Sets = Impl::build(Tables, 0);
+        Automaton Result;
+        for (int Symbol = 0; Symbol < SymbolsCount; ++Symbol) {
+            Result.Symbols[Symbol] = Tables.Symbols[Symbol].Words[0];
+        }
+        for (size_t k = 0; k < Chunks; ++k) {
+            for (size_t Bits = 1; Bits < 256; ++Bits) {
+                size_t Lowest = __builtin_ctz(Bits);
+                Result.Follow[k][Bits] = Result.Follow[k][Bits & (Bits - 1)] | Tables.Follow[k * 8 + Lowest].Words[0];
+            }
+        }
+        Result.First = Sets.First.Words[0];
+        Result.Last = Sets.Last.Words[0];
+        Result.Nullable = Sets.Nullable;
+        return Result;
+    }
+    static constexpr Automaton Glushkov = build();
+    static constexpr uint64_t next(uint64_t state, int symbol) {
+        uint64_t Next = 0;
+        for (size_t k = 0; k < Chunks; ++k) {
+            Next |= Glushkov.Follow[k][state >> (8 * k) & 0xff];
+        }
+        return Next & Glushkov.Symbols[symbol];
+    }
+    // As Regex::prefix. Before the first byte the state is the start together
+    // with the positions that read BeginSymbol, so the first step is taken from
+    // both.
+    template <bool First>
+    static constexpr size_t prefix(const char *str, size_t length) {
+        uint64_t begun = Glushkov.First & Glushkov.Symbols[BeginSymbol];
+        size_t end = std::string_view::npos;
+        if (Glushkov.Nullable || (begun & Glushkov.Last) != 0) {
+            end = 0;
+            if (First) {
+                return end;
+            }
+        }
+        if (length == 0) {
+            uint64_t ended = (Glushkov.First & Glushkov.Symbols[EndSymbol]) | next(begun, EndSymbol);
+            return (ended & Glushkov.Last) != 0 ? 0 : end;
+        }
+        unsigned char c = str[0];
+        uint64_t state = (Glushkov.First & Glushkov.Symbols[c]) | next(begun, c);
+        size_t i = 1;
+        for (; ; ++i) {
+            if ((state & Glushkov.Last) != 0) {
+                end = i;
+                if (First) {
+                    return end;
+                }
+            }
+            if (i == length || state == 0) {
+                break;
+            }
+            state = next(state, static_cast<unsigned char>(str[i]));
+        }
+        if (i == length && end != length && (next(state, EndSymbol) & Glushkov.Last) != 0) {
+            end = length;
+        }
+        return end;
+    }
+public:
+    static bool match(const std::string &str) {
+        return match(str.data(), str.length());
+    }
+    static constexpr bool match(const char *str, size_t length) {
+        uint64_t state = Glushkov.First & Glushkov.Symbols[BeginSymbol];
+        for (size_t i = 0; i < length; ++i) {
+            if (state == 0) {
+                return false;
+            }
+            state = next(state, static_cast<unsigned char>(str[i]));
+        }
+        state = next(state, EndSymbol);
+        return (state & Glushkov.Last) != 0;
+    }
+    static constexpr bool match(const char *str) {
+        uint64_t state = Glushkov.First & Glushkov.Symbols[BeginSymbol];
+        for (size_t i = 0; str[i]; ++i) {
+            if (state == 0) {
+                return false;
+            }
+            state = next(state, static_cast<unsigned char>(str[i]));
+        }
+        state = next(state, EndSymbol);
+        return (state & Glushkov.Last) != 0;
+    }
+    static size_t match_prefix(const std::string &str) {
+        return match_prefix(str.data(), str.length());
+    }
+    static constexpr size_t match_prefix(const char *str, size_t length) {
+        return prefix<false>(str, length);
+    }
+    static constexpr size_t match_prefix(const char *str) {
+        return match_prefix(str, std::char_traits<char>::length(str));
+    }
+    static size_t first_accept(const std::string &str) {
+        return first_accept(str.data(), str.length());
+    }
+    static constexpr size_t first_accept(const char *str, size_t length) {
+        return prefix<true>(str, length);
+    }
+    static constexpr size_t first_accept(const char *str) {
+        return first_accept(str, std::char_traits<char>::length(str));
+    }
+    // The same over binary buffers, see ByteInput.
+    template <typename B, typename = ByteInput<B>>
+    static bool match(const B *data, size_t length) {
+        return match(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static size_t match_prefix(const B *data, size_t length) {
+        return match_prefix(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static size_t first_accept(const B *data, size_t length) {
+        return first_accept(byte_chars(data), length);
+    }
+};
+
+template <typename R>
+class Regex<R, CountingEngine> {
+private:
+    using Impl = GlushkovImpl<CountRuns<R>>;
+    static_assert(Impl::Positions <= 64, "CountingEngine supports at most 64 positions");
+    static constexpr size_t Chunks = Impl::Positions == 0 ? 1 : (Impl::Positions + 7) / 8;
+    // A counted position, with the bit where its ring starts, see Run.
+    struct Counter {
+        uint64_t Position = 0;
+        size_t Min = 0;
+        size_t Max = 0;
+        size_t Ring = 0;
+    };
+    struct Automaton {
+        // As for BitParallelEngine.
+        ConstexprArray<uint64_t, SymbolsCount> Symbols;
+        ConstexprArray<ConstexprArray<uint64_t, 256>, Chunks> Follow;
+        uint64_t First = 0;
+        uint64_t Last = 0;
+        bool Nullable = false;
+        uint64_t Counted = 0;
+        ConstexprArray<Counter, 64> Counters;
+        size_t CountersSize = 0;
+        size_t RingBits = 0;
+    };
+    static constexpr Automaton build() {
+        GlushkovTables<Chunks * 8> Tables;
+        GlushkovSets<Chunks * 8> Sets = Impl::build(Tables, 0);
+        Automaton Result;
+        for (int Symbol = 0; Symbol < SymbolsCount; ++Symbol) {
+            Result.Symbols[Symbol] = Tables.Symbols[Symbol].Words[0];
+        }
+        for (size_t k = 0; k < Chunks; ++k) {
+            for (size_t Bits = 1; Bits < 256; ++Bits) {
+                size_t Lowest = __builtin_ctz(Bits);
+                Result.Follow[k][Bits] = Result.Follow[k][Bits & (Bits - 1)] | Tables.Follow[k * 8 + Lowest].Words[0];
+            }
+        }
+        Result.First = Sets.First.Words[0];
+        Result.Last = Sets.Last.Words[0];
+        Result.Nullable = Sets.Nullable;
+        for (size_t p = 0; p < Impl::Positions; ++p) {
+            if (Tables.Counters[p].Max == 0) {
+                continue;
+            }
+            // A run of no symbols is left to Nullable, so the counter itself
+            // only ever exits after one symbol at least.
+            Counter &Counter_ = Result.Counters[Result.CountersSize++];
+            Counter_.Position = uint64_t(1) << p;
+            Counter_.Min = Tables.Counters[p].Min == 0 ? 1 : Tables.Counters[p].Min;
+            Counter_.Max = Tables.Counters[p].Max;
+            Counter_.Ring = Result.RingBits;
+            Result.Counted |= Counter_.Position;
+            Result.RingBits += Counter_.Max + 1;
+        }
+        return Result;
+    }
+    static constexpr Automaton Glushkov = build();
+    static constexpr size_t CounterSlots = Glushkov.CountersSize == 0 ? 1 : Glushkov.CountersSize;
+    static constexpr size_t RingWords = Glushkov.RingBits / 64 + 1;
+    static constexpr uint64_t follow(uint64_t state) {
+        uint64_t Next = 0;
+        for (size_t k = 0; k < Chunks; ++k) {
+            Next |= Glushkov.Follow[k][state >> (8 * k) & 0xff];
+        }
+        return Next;
+    }
+    // The state of the simulation. A counted position is active while some of
+    // the runs it was entered for are at most Max symbols long, and may be left
+    // once the longest of them is at least Min long. As a run of the class goes
+    // on, all of them grow by one together, so a counter only keeps the steps of
+    // the current run at which it was entered, in a ring of Max + 1 bits, and
+    // the oldest and the newest of them. Whether the position may be left is
+    // then a subtraction; the ring is only written on entry and only searched
+    // once the oldest entry passes Max, for the next one. A symbol outside the
+    // class ends the run.
+    struct Run {
+        struct Count {
+            // Steps count from 1, so 0 is none. The rest is only read while
+            // Oldest is some step.
+            size_t Step = 0;
+            size_t Oldest = 0;
+            size_t OldestSlot = 0;
+            size_t Newest = 0;
+            size_t NewestSlot = 0;
+        };
+        uint64_t state = 0;
+        ConstexprArray<uint64_t, RingWords> Ring;
+        ConstexprArray<Count, CounterSlots> Counts;
+        constexpr explicit Run(uint64_t state_) : state(state_) {}
+        // The active positions that may be followed. The counters are gone
+        // through one by one at compile time, so that their bounds are
+        // constants.
+        template <size_t... K>
+        constexpr uint64_t exits(std::index_sequence<K...>) const {
+            uint64_t Result = state & ~Glushkov.Counted;
+            ((Result |= Counts[K].Oldest != 0 && Counts[K].Step - Counts[K].Oldest + 1 >= Glushkov.Counters[K].Min
+                ? Glushkov.Counters[K].Position : 0), ...);
+            return Result;
+        }
+        constexpr uint64_t exits() const {
+            return exits(std::make_index_sequence<Glushkov.CountersSize>());
+        }
+        constexpr bool accepts() const {
+            return (exits() & Glushkov.Last) != 0;
+        }
+        // Clears Size slots of the ring of Counter_ from Slot on, or with Find
+        // stops at the first set one and returns how many come before it.
+        template <bool Find>
+        constexpr size_t scan(const Counter &Counter_, size_t Slot, size_t Size) {
+            for (size_t Done = 0; Done < Size;) {
+                size_t i = Counter_.Ring + Slot;
+                size_t Span = std::min({64 - i % 64, Counter_.Max + 1 - Slot, Size - Done});
+                uint64_t Mask = (Span == 64 ? ~uint64_t(0) : (uint64_t(1) << Span) - 1) << (i % 64);
+                if (!Find) {
+                    Ring[i / 64] &= ~Mask;
+                } else if ((Ring[i / 64] & Mask) != 0) {
+                    return Done + __builtin_ctzll(Ring[i / 64] & Mask) - i % 64;
+                }
+                Done += Span;
+                Slot = Slot + Span == Counter_.Max + 1 ? 0 : Slot + Span;
+            }
+            return Size;
+        }
+        // Records an entry at the current step, after the newest one.
+        constexpr void enter(const Counter &Counter_, Count &Count_) {
+            size_t Slot = 0;
+            if (Count_.Oldest == 0) {
+                Count_.Oldest = Count_.Step;
+                Count_.OldestSlot = Slot;
+            } else {
+                // The oldest entry is at most Max steps back, so the new slot
+                // does not wrap onto it.
+                Slot = Count_.NewestSlot + (Count_.Step - Count_.Newest);
+                Slot = Slot > Counter_.Max ? Slot - Counter_.Max - 1 : Slot;
+                size_t After = Count_.NewestSlot == Counter_.Max ? 0 : Count_.NewestSlot + 1;
+                scan<false>(Counter_, After, Count_.Step - Count_.Newest - 1);
+            }
+            size_t i = Counter_.Ring + Slot;
+            Ring[i / 64] |= uint64_t(1) << (i % 64);
+            Count_.Newest = Count_.Step;
+            Count_.NewestSlot = Slot;
+        }
+        // Drops the oldest entry, whose run has passed Max.
+        constexpr void expire(const Counter &Counter_, Count &Count_) {
+            if (Count_.Oldest == Count_.Newest) {
+                Count_.Oldest = 0;
+                return;
+            }
+            size_t After = Count_.OldestSlot == Counter_.Max ? 0 : Count_.OldestSlot + 1;
+            size_t Skipped = scan<true>(Counter_, After, Count_.Newest - Count_.Oldest) + 1;
+            Count_.Oldest += Skipped;
+            Count_.OldestSlot += Skipped;
+            if (Count_.OldestSlot > Counter_.Max) {
+                Count_.OldestSlot -= Counter_.Max + 1;
+            }
+        }
+        // Counts symbol with the K-th counter, given the positions that read
+        // it, and sets its position in Next if it is still active.
+        template <size_t K>
+        constexpr void count(int symbol, uint64_t &Next) {
+            constexpr Counter Counter_ = Glushkov.Counters[K];
+            Count &Count_ = Counts[K];
+            bool Entered = (Next & Counter_.Position) != 0;
+            if ((Glushkov.Symbols[symbol] & Counter_.Position) == 0 || (!Entered && Count_.Oldest == 0)) {
+                Count_.Step = 0;
+                Count_.Oldest = 0;
+                return;
+            }
+            ++Count_.Step;
+            if (Entered) {
+                enter(Counter_, Count_);
+            }
+            if (Count_.Oldest != 0 && Count_.Step - Count_.Oldest >= Counter_.Max) {
+                expire(Counter_, Count_);
+            }
+            Next = Count_.Oldest != 0 ? Next | Counter_.Position : Next & ~Counter_.Position;
+        }
+        template <size_t... K>
+        constexpr void count(int symbol, uint64_t &Next, std::index_sequence<K...>) {
+            (count<K>(symbol, Next), ...);
+        }
+        // Reads symbol, also entering Start if it reads it.
+        constexpr void step(int symbol, uint64_t Start = 0) {
+            uint64_t Next = (follow(exits()) | Start) & Glushkov.Symbols[symbol];
+            if constexpr (Glushkov.CountersSize != 0) {
+                count(symbol, Next, std::make_index_sequence<Glushkov.CountersSize>());
+            }
+            state = Next;
+        }
+        // Whether the input may end here.
+        constexpr bool ends(uint64_t Start = 0) const {
+            return ((follow(exits()) | Start) & Glushkov.Symbols[EndSymbol] & Glushkov.Last) != 0;
+        }
+    };
+
+    static constexpr uint64_t Begun = Glushkov.First & Glushkov.Symbols[BeginSymbol];
+    // As Regex::prefix.
+    template <bool First>
+    static constexpr size_t prefix(const char *str, size_t length) {
+        Run run(Begun);
+        size_t end = std::string_view::npos;
+        if (Glushkov.Nullable || run.accepts()) {
+            end = 0;
+            if (First) {
+                return end;
+            }
+        }
+        if (length == 0) {
+            return run.ends(Glushkov.First) ? 0 : end;
+        }
+        run.step(static_cast<unsigned char>(str[0]), Glushkov.First);
+        size_t i = 1;
+        for (; ; ++i) {
+            if (run.accepts()) {
+                end = i;
+                if (First) {
+                    return end;
+                }
+            }
+            if (i == length || run.state == 0) {
+                break;
+            }
+            run.step(static_cast<unsigned char>(str[i]));
+        }
+        if (i == length && end != length && run.ends()) {
+            end = length;
+        }
+        return end;
+    }
+public:
+    static bool match(const std::string &str) {
+        return match(str.data(), str.length());
+    }
+    static constexpr bool match(const char *str, size_t length) {
+        Run run(Begun);
+        for (size_t i = 0; i < length; ++i) {
+            if (run.state == 0) {
+                return false;
+            }
+            run.step(static_cast<unsigned char>(str[i]));
+        }
+        return run.ends();
+    }
+    static constexpr bool match(const char *str) {
+        return match(str, std::char_traits<char>::length(str));
+    }
+    static size_t match_prefix(const std::string &str) {
+        return match_prefix(str.data(), str.length());
+    }
+    static constexpr size_t match_prefix(const char *str, size_t length) {
+        return prefix<false>(str, length);
+    }
+    static constexpr size_t match_prefix(const char *str) {
+        return match_prefix(str, std::char_traits<char>::length(str));
+    }
+    static size_t first_accept(const std::string &str) {
+        return first_accept(str.data(), str.length());
+    }
+    static constexpr size_t first_accept(const char *str, size_t length) {
+        return prefix<true>(str, length);
+    }
+    static constexpr size_t first_accept(const char *str) {
+        return first_accept(str, std::char_traits<char>::length(str));
+    }
+    // Returns whether any substring of str matches, as Regex::search. A match
+    // may start at every byte, so each step enters the first positions again.
+    static bool search(const std::string &str) {
+        return search(str.data(), str.length());
+    }
+    static constexpr bool search(const char *str, size_t length) {
+        if (Glushkov.Nullable) {
+            return true;
+        }
+        Run run(Begun);
+        for (size_t i = 0; i < length; ++i) {
+            if (run.accepts()) {
+                return true;
+            }
+            run.step(static_cast<unsigned char>(str[i]), Glushkov.First);
+        }
+        return run.accepts() || run.ends(Glushkov.First);
+    }
+    static constexpr bool search(const char *str) {
+        return search(str, std::char_traits<char>::length(str));
+    }
+    // The same over binary buffers, see ByteInput.
+    template <typename B, typename = ByteInput<B>>
+    static bool match(const B *data, size_t length) {
+        return match(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static size_t match_prefix(const B *data, size_t length) {
+        return match_prefix(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static size_t first_accept(const B *data, size_t length) {
+        return first_accept(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static bool search(const B *data, size_t length) {
+        return search(byte_chars(data), length);
+    }
+};
+
+template <typename R, size_t CacheStates>
+class Regex<R, LazyDFAEngine<CacheStates>> {
+private:
+    using Impl = GlushkovImpl<R>;
+    // The last position is the start, which is followed by the first positions.
+    static constexpr size_t Positions = Impl::Positions + 1;
+    static constexpr size_t Start = Impl::Positions;
+    using Set = PatternMask<Positions>;
+    struct Automaton {
+        GlushkovTables<Positions> Tables;
+        Set Last;
+        bool Nullable = false;
+        // Bytes read by the same positions share a column, then BeginSymbol and
+        // EndSymbol have a column each.
+        ByteClassMap ByteClasses;
+        ConstexprArray<int, 258> Representatives;
+        size_t Columns = 0;
+    };
+    static constexpr Automaton build() {
+        Automaton Result;
+        GlushkovSets<Positions> Sets = Impl::build(Result.Tables, 0);
+        Result.Tables.Follow[Start] = Sets.First;
+        Result.Last = Sets.Last;
+        Result.Nullable = Sets.Nullable;
+        for (int c = 0; c < 256; ++c) {
+            size_t Class = Result.Columns;
+            for (size_t k = 0; k < Result.Columns; ++k) {
+                if (Result.Tables.Symbols[Result.Representatives[k]] == Result.Tables.Symbols[c]) {
+                    Class = k;
+                    break;
+                }
+            }
+            if (Class == Result.Columns) {
+                Result.Representatives[Result.Columns++] = c;
+            }
+            Result.ByteClasses[c] = Class;
+        }
+        Result.Representatives[Result.Columns++] = BeginSymbol;
+        Result.Representatives[Result.Columns++] = EndSymbol;
+        return Result;
+    }
+    static constexpr Automaton Glushkov = build();
+    static constexpr size_t Stride = Glushkov.Columns;
+    static constexpr size_t BeginColumn = Stride - 2;
+    static constexpr size_t EndColumn = Stride - 1;
+    // States are premultiplied row numbers. Row 0 is the dead state and row 1
+    // the start state, which are added again whenever the cache is flushed.
+    // prefix starts from the start state and the state after BeginSymbol in
+    // one, which is added when first needed.
+    static constexpr uint32_t DeadState = 0;
+    static constexpr uint32_t StartState = Stride;
+    // A flush must leave room for the state the flushing transition leads to.
+    static_assert(CacheStates >= 3, "LazyDFAEngine needs a cache of at least 3 states");
+    static constexpr Set prefix_start() {
+        Set Result = Glushkov.Tables.Follow[Start] & Glushkov.Tables.Symbols[BeginSymbol];
+        Result.set(Start);
+        return Result;
+    }
+    // The DFA states built so far and their transitions, with Unknown for those
+    // not followed yet. If Unanchored, every state also holds the start
+    // position, so that a match may begin anywhere.
+    template <bool Unanchored>
+    class Cache {
+    public:
+        Cache() : table_(CacheStates * Stride), sets_(CacheStates), final_(CacheStates), slots_(2 * CacheStates) {
+            flush();
+        }
+        uint32_t next(uint32_t state, size_t column) {
+            uint32_t Next = table_[state + column];
+            if (Next == Unknown) {
+                Next = add(state, column);
+            }
+            return Next;
+        }
+        bool is_final(uint32_t state) const {
+            return final_[state / Stride];
+        }
+        uint32_t prefix_state() {
+            if (prefix_state_ == Unknown) {
+                prefix_state_ = find_or_insert(prefix_start());
+                if (prefix_state_ == Unknown) {
+                    flush();
+                    prefix_state_ = find_or_insert(prefix_start());
+                }
+            }
+            return prefix_state_;
+        }
+    private:
+        static constexpr uint32_t Unknown = UINT32_MAX;
+        void flush() {
+            std::fill(table_.begin(), table_.end(), Unknown);
+            std::fill(slots_.begin(), slots_.end(), 0);
+            rows_ = 0;
+            find_or_insert(Set());
+            Set Initial;
+            Initial.set(Start);
+            find_or_insert(Initial);
+            prefix_state_ = Unknown;
+        }
+        static size_t hash(const Set &Key) {
+            uint64_t Hash = 14695981039346656037ull;
+            for (size_t k = 0; k < Key.Words.size(); ++k) {
+                Hash = (Hash ^ Key.Words[k]) * 1099511628211ull;
+            }
+            return Hash ^ Hash >> 32;
+        }
+        // Returns the state of the positions, or Unknown if the cache is full.
+        uint32_t find_or_insert(const Set &Key) {
+            size_t Slot = hash(Key) % slots_.size();
+            for (; slots_[Slot] != 0; Slot = (Slot + 1) % slots_.size()) {
+                if (sets_[slots_[Slot] - 1] == Key) {
+                    return (slots_[Slot] - 1) * Stride;
+                }
+            }
+            if (rows_ == CacheStates) {
+                return Unknown;
+            }
+            sets_[rows_] = Key;
+            final_[rows_] = (Key & Glushkov.Last).any();
+            slots_[Slot] = ++rows_;
+            return (rows_ - 1) * Stride;
+        }
+        // Follows a transition for the first time. When the cache is full it is
+        // flushed, and the transition is not recorded since state is gone.
+        uint32_t add(uint32_t state, size_t column) {
+            const Set &From = sets_[state / Stride];
+            Set To;
+            for (size_t k = 0; k < From.Words.size(); ++k) {
+                for (uint64_t Bits = From.Words[k]; Bits; Bits &= Bits - 1) {
+                    To |= Glushkov.Tables.Follow[k * 64 + __builtin_ctzll(Bits)];
+                }
+            }
+            To &= Glushkov.Tables.Symbols[Glushkov.Representatives[column]];
+            if (Unanchored) {
+                To.set(Start);
+            }
+            uint32_t Next = find_or_insert(To);
+            if (Next == Unknown) {
+                flush();
+                return find_or_insert(To);
+            }
+            table_[state + column] = Next;
+            return Next;
+        }
+        std::vector<uint32_t> table_;
+        std::vector<Set> sets_;
+        std::vector<bool> final_;
+        std::vector<uint32_t> slots_;
+        size_t rows_ = 0;
+        uint32_t prefix_state_ = Unknown;
+    };
+    template <bool Unanchored>
+    static Cache<Unanchored> &cache() {
+        thread_local Cache<Unanchored> Instance;
+        return Instance;
+    }
+public:
+    static bool match(const std::string &str) {
+        return match(str.data(), str.length());
+    }
+    static bool match(const char *str, size_t length) {
+        Cache<false> &Cache_ = cache<false>();
+        uint32_t state = Cache_.next(StartState, BeginColumn);
+        for (size_t i = 0; i < length; ++i) {
+            if (state == DeadState) {
+                return false;
+            }
+            state = Cache_.next(state, Glushkov.ByteClasses[static_cast<unsigned char>(str[i])]);
+        }
+        return Cache_.is_final(Cache_.next(state, EndColumn));
+    }
+    static bool match(const char *str) {
+        return match(str, std::char_traits<char>::length(str));
+    }
+private:
+    // As Regex::prefix.
+    template <bool First>
+    static size_t prefix(const char *str, size_t length) {
+        Cache<false> &Cache_ = cache<false>();
+        uint32_t state = Cache_.prefix_state();
+        size_t end = std::string_view::npos;
+        size_t i = 0;
+        for (; ; ++i) {
+            if (Cache_.is_final(state) || (i == 0 && Glushkov.Nullable)) {
+                end = i;
+                if (First) {
+                    return end;
+                }
+            }
+            if (i == length || state == DeadState) {
+                break;
+            }
+            state = Cache_.next(state, Glushkov.ByteClasses[static_cast<unsigned char>(str[i])]);
+        }
+        if (i == length && end != length && Cache_.is_final(Cache_.next(state, EndColumn))) {
+            end = length;
+        }
+        return end;
+    }
+public:
+    static size_t match_prefix(const std::string &str) {
+        return match_prefix(str.data(), str.length());
+    }
+    static size_t match_prefix(const char *str, size_t length) {
+        return prefix<false>(str, length);
+    }
+    static size_t match_prefix(const char *str) {
+        return match_prefix(str, std::char_traits<char>::length(str));
+    }
+    static size_t first_accept(const std::string &str) {
+        return first_accept(str.data(), str.length());
+    }
+    static size_t first_accept(const char *str, size_t length) {
+        return prefix<true>(str, length);
+    }
+    static size_t first_accept(const char *str) {
+        return first_accept(str, std::char_traits<char>::length(str));
+    }
+    // Returns whether any substring of str matches, as Regex::search.
+    static bool search(const std::string &str) {
+        return search(str.data(), str.length());
+    }
+    static bool search(const char *str, size_t length) {
+        if (Glushkov.Nullable) {
+            return true;
+        }
+        Cache<true> &Cache_ = cache<true>();
+        uint32_t state = Cache_.next(StartState, BeginColumn);
+        for (size_t i = 0; i < length; ++i) {
+            if (Cache_.is_final(state)) {
+                return true;
+            }
+            state = Cache_.next(state, Glushkov.ByteClasses[static_cast<unsigned char>(str[i])]);
+        }
+        return Cache_.is_final(state) || Cache_.is_final(Cache_.next(state, EndColumn));
+    }
+    static bool search(const char *str) {
+        return search(str, std::char_traits<char>::length(str));
+    }
+    // The same over binary buffers, see ByteInput.
+    template <typename B, typename = ByteInput<B>>
+    static bool match(const B *data, size_t length) {
+        return match(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static size_t match_prefix(const B *data, size_t length) {
+        return match_prefix(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static size_t first_accept(const B *data, size_t length) {
+        return first_accept(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static bool search(const B *data, size_t length) {
+        return search(byte_chars(data), length);
+    }
+};
+
+template <typename R>
+class Regex<R, DirectCodedEngine> {
+private:
+    using DFA_ = CompileRegex<R>;
+    // The DFA of R between optional BeginSymbol and EndSymbol, for prefixes.
+    using Anchored = CompileRegex<Concat<Option<Begin>, R, Option<End>>>;
+    // A set of bytes, tested with one range comparison if they are contiguous,
+    // otherwise with a 256-bit membership mask.
+    struct ByteGroup {
+        ConstexprArray<uint64_t, 4> Members;
+        int First = -1;
+        int Last = -1;
+        bool Contiguous = true;
+        constexpr void add(int c) {
+            if (First == -1) {
+                First = c;
+            } else if (Last != c - 1) {
+                Contiguous = false;
+            }
+            Last = c;
+            Members[c / 64] |= uint64_t(1) << (c % 64);
+        }
+    };
+    // Where a run stopped: the position of the next byte, the end of the
+    // longest accepting prefix seen, and whether it only paused.
+    struct Stop {
+        size_t i;
+        size_t end;
+        bool paused;
+    };
+    // The code of D. Each state is a function of its own, which loops over the
+    // bytes that keep it in that state, then tests the bytes of each other live
+    // target and calls the function of that target. The calls are tail calls
+    // with the same arguments, which the compiler turns into jumps, so the state
+    // lives in the program counter. Every Budget transitions the functions
+    // return to run() instead, which dispatches on the state once and goes on,
+    // so that the depth of the calls stays bounded in constant evaluation and
+    // without optimization. If Prefix, the functions of final states record
+    // where the longest accepting prefix ends, and if First, they stop there.
+    template <typename D, bool Prefix, bool First = false>
+    struct Coded {
+        using State = typename D::State;
+        // The bytes that lead out of state Row, one group per live target, and
+        // in the last group the bytes that stay in Row.
+        template <size_t Row>
+        struct Code {
+            static constexpr State Id = static_cast<State>(Row * D::Stride);
+            static constexpr size_t count() {
+                ConstexprArray<State, 256> Targets;
+                size_t Count = 0;
+                for (int c = 0; c < 256; ++c) {
+                    State Next = D::next(Id, c);
+                    size_t k = 0;
+                    for (; k < Count && Targets[k] != Next; ++k);
+                    if (k == Count && Next != D::DeadState && Next != Id) {
+                        Targets[Count++] = Next;
+                    }
+                }
+                return Count;
+            }
+            static constexpr size_t Count = count();
+            struct Groups {
+                ConstexprArray<State, Count + 1> Target;
+                ConstexprArray<ByteGroup, Count + 1> Bytes;
+            };
+            static constexpr Groups build() {
+                Groups Result;
+                Result.Target[Count] = Id;
+                size_t Size = 0;
+                for (int c = 0; c < 256; ++c) {
+                    State Next = D::next(Id, c);
+                    if (Next == D::DeadState) {
+                        continue;
+                    }
+                    size_t k = 0;
+                    if (Next == Id) {
+                        k = Count;
+                    } else {
+                        for (; k < Size && Result.Target[k] != Next; ++k);
+                        if (k == Size) {
+                            Result.Target[Size++] = Next;
+                        }
+                    }
+                    Result.Bytes[k].add(c);
+                }
+                return Result;
+            }
+            static constexpr Groups Exits = build();
+            // Only the masks in use end up in the binary.
+            template <size_t K>
+            static constexpr ConstexprArray<uint64_t, 4> Members = Exits.Bytes[K].Members;
+            template <size_t K>
+            static constexpr bool contains(unsigned char c) {
+                constexpr ByteGroup Bytes = Exits.Bytes[K];
+                if constexpr (Bytes.First == -1) {
+                    return false;
+                } else if constexpr (Bytes.Contiguous) {
+                    return static_cast<unsigned char>(c - Bytes.First) <= Bytes.Last - Bytes.First;
+                } else {
+                    return Members<K>[c >> 6] >> (c & 63) & 1;
+                }
+            }
+        };
+        template <size_t Row>
+        static constexpr State state(const char *str, size_t length, size_t i, size_t end, size_t budget, Stop &stop) {
+            using C = Code<Row>;
+            if constexpr (C::Id == D::DeadState) {
+                stop = {i, end, false};
+                return C::Id;
+            } else {
+                for (; i < length; ++i) {
+                    if constexpr (Prefix && D::is_final(C::Id)) {
+                        end = i;
+                        if constexpr (First) {
+                            stop = {i, end, false};
+                            return C::Id;
+                        }
+                    }
+                    if (!C::template contains<C::Count>(str[i])) {
+                        return leave<Row, 0>(str, length, i + 1, end, budget, stop);
+                    }
+                }
+                if constexpr (Prefix && D::is_final(C::Id)) {
+                    end = i;
+                }
+                stop = {i, end, false};
+                return C::Id;
+            }
+        }
+        // Moves on from Row on str[i - 1], which does not keep it there.
+        template <size_t Row, size_t K>
+        static constexpr State leave(const char *str, size_t length, size_t i, size_t end, size_t budget, Stop &stop) {
+            using C = Code<Row>;
+            if constexpr (K == C::Count) {
+                stop = {i, end, false};
+                return D::DeadState;
+            } else {
+                if (C::template contains<K>(str[i - 1])) {
+                    constexpr State Target = C::Exits.Target[K];
+                    if (budget == 0) {
+                        stop = {i, end, true};
+                        return Target;
+                    }
+                    return state<Target / D::Stride>(str, length, i, end, budget - 1, stop);
+                }
+                return leave<Row, K + 1>(str, length, i, end, budget, stop);
+            }
+        }
+        template <size_t... Rows>
+        static constexpr size_t max_count(std::index_sequence<Rows...>) {
+            size_t Max = 0;
+            ((Max = std::max(Max, Code<Rows>::Count)), ...);
+            return Max;
+        }
+        // A transition nests at most Count + 2 calls.
+        static constexpr size_t Budget = std::max<size_t>(1, 128 / (max_count(std::make_index_sequence<D::States>()) + 2));
+        template <size_t... Rows>
+        static constexpr State dispatch(State from, const char *str, size_t length, Stop &stop, std::index_sequence<Rows...>) {
+            State Next = D::DeadState;
+            size_t i = stop.i;
+            size_t end = stop.end;
+            ((from == Rows * D::Stride && (Next = state<Rows>(str, length, i, end, Budget, stop), true)) || ...);
+            return Next;
+        }
+        // Runs from state from over str and returns the state it stops in:
+        // the one at the end of str, the dead state, or with First the first
+        // final one. stop tells where.
+        static constexpr State run(State from, const char *str, size_t length, Stop &stop) {
+            stop = {0, std::string_view::npos, true};
+            while (stop.paused) {
+                from = dispatch(from, str, length, stop, std::make_index_sequence<D::States>());
+            }
+            return from;
+        }
+    };
+    // As Regex::prefix.
+    template <bool First>
+    static constexpr size_t prefix(const char *str, size_t length) {
+        Stop stop{};
+        typename Anchored::State state = Coded<Anchored, true, First>::run(
+            Anchored::transition(Anchored::StartState, Anchored::BeginClass), str, length, stop);
+        if (stop.i == length && stop.end != length && Anchored::is_final(Anchored::transition(state, Anchored::EndClass))) {
+            return length;
+        }
+        return stop.end;
+    }
+public:
+    static bool match(const std::string &str) {
+        return match(str.data(), str.length());
+    }
+    static constexpr bool match(const char *str, size_t length) {
+        Stop stop{};
+        typename DFA_::State state = Coded<DFA_, false>::run(DFA_::transition(DFA_::StartState, DFA_::BeginClass), str, length, stop);
+        return DFA_::is_final(DFA_::transition(state, DFA_::EndClass));
+    }
+    static constexpr bool match(const char *str) {
+        return match(str, std::char_traits<char>::length(str));
+    }
+    static size_t match_prefix(const std::string &str) {
+        return match_prefix(str.data(), str.length());
+    }
+    static constexpr size_t match_prefix(const char *str, size_t length) {
+        return prefix<false>(str, length);
+    }
+    static constexpr size_t match_prefix(const char *str) {
+        return match_prefix(str, std::char_traits<char>::length(str));
+    }
+    static size_t first_accept(const std::string &str) {
+        return first_accept(str.data(), str.length());
+    }
+    static constexpr size_t first_accept(const char *str, size_t length) {
+        return prefix<true>(str, length);
+    }
+    static constexpr size_t first_accept(const char *str) {
+        return first_accept(str, std::char_traits<char>::length(str));
+    }
+    // The same over binary buffers, see ByteInput.
+    template <typename B, typename = ByteInput<B>>
+    static bool match(const B *data, size_t length) {
+        return match(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static size_t match_prefix(const B *data, size_t length) {
+        return match_prefix(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static size_t first_accept(const B *data, size_t length) {
+        return first_accept(byte_chars(data), length);
+    }
+};
+
+template <typename R>
+struct PatternOf {
+    using Type = R;
+};
+
+template <typename R, typename Engine>
+struct PatternOf<Regex<R, Engine>> {
+    using Type = R;
+};
+
+// ICase of a Regex type, e.g. of ParseRegex, is the same Regex of ICase<R>.
+template <typename R, typename Engine>
+struct ICaseImpl<Regex<R, Engine>> {
+    using Type = Regex<ICase<R>, Engine>;
+};
+
+// Matches a string against several patterns in a single pass, with the product
+// of their DFAs. The patterns are AST types or Regex types. Bit i of the result
+// is set iff the i-th pattern matches, as Regex::match or Regex::search would
+// report it.
+template <typename... R>
+class RegexSet {
+public:
+    static constexpr size_t Size = sizeof...(R);
+    using Matches = PatternMask<Size>;
+private:
+    static_assert(Size > 0, "RegexSet needs at least one pattern");
+    static constexpr size_t Capacity = 4096;
+    // Only built when used.
+    struct Automata {
+        using Match = ProductDFA<Capacity, ProductMode::Match, CompileRegex<typename PatternOf<R>::Type>...>;
+        // A component accepts for good once its pattern has matched, so only the
+        // state at the end of the input matters.
+        using Search = ProductDFA<Capacity, ProductMode::Match, CompileRegex<Concat<
+            Option<Begin>, Star<Any>, typename PatternOf<R>::Type, Star<Any>, Option<End>
+        >>...>;
+    };
+    template <typename DFA_>
+    static constexpr Matches run(const char *str, size_t length) {
+        typename DFA_::State state = DFA_::StartState;
+        for (size_t i = 0; i < length && state != DFA_::DeadState; ++i) {
+            state = DFA_::next(state, str[i]);
+        }
+        return DFA_::Finals[state / DFA_::Stride];
+    }
+public:
+    static Matches match(const std::string &str) {
+        return match(str.data(), str.length());
+    }
+    static constexpr Matches match(const char *str, size_t length) {
+        return run<typename Automata::Match>(str, length);
+    }
+    static constexpr Matches match(const char *str) {
+        return match(str, std::char_traits<char>::length(str));
+    }
+    static Matches search(const std::string &str) {
+        return search(str.data(), str.length());
+    }
+    static constexpr Matches search(const char *str, size_t length) {
+        return run<typename Automata::Search>(str, length);
+    }
+    static constexpr Matches search(const char *str) {
+        return search(str, std::char_traits<char>::length(str));
+    }
+    // The same over binary buffers, see ByteInput.
+    template <typename B, typename = ByteInput<B>>
+    static Matches match(const B *data, size_t length) {
+        return match(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    static Matches search(const B *data, size_t length) {
+        return search(byte_chars(data), length);
+    }
+};
@@ -0,0 +1,643 @@
+#pragma once
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "regex.hpp"
+#include "parser.hpp"
+
+// Compiles patterns that are only known at run time. The syntax is the one of
+// parser.hpp and the pipeline mirrors the compile time one: the pattern is parsed
+// to an AST, turned into a Thompson NFA, determinized by subset construction over
+// symbol classes, minimized by Moore refinement and packed into a flat table with
+// the layout of PackedDFA, only held in heap arrays.
+namespace Runtime {
+using SymbolSet = std::bitset<SymbolsCount>;
+
+struct Node {
+    enum class Kind {
+        Symbols,
+        Empty,
+        Concat,
+        Union,
+        Star,
+        Plus,
+        Option,
+        Repeat
+    };
+    Kind kind;
+    SymbolSet symbols;
+    std::vector<size_t> children;
+    // Bounds of Repeat, Max is -1 when there is none.
+    int min = 0;
+    int max = 0;
+};
+
+// Recursive descent parser. Nodes refer to each other by index into nodes.
+class Parser {
+public:
+    explicit Parser(std::string_view pattern) : pattern_(pattern), pos_(0) {}
+    std::vector<Node> parse(size_t &root) {
+        root = parse_union();
+        if (pos_ != pattern_.size()) {
+            fail("Parentheses don't match!");
+        }
+        return std::move(nodes_);
+    }
+private:
+    [[noreturn]] void fail(const char *message) const {
+        throw std::invalid_argument(std::string(message) + " at offset " + std::to_string(pos_));
+    }
+    bool at_end() const {
+        return pos_ == pattern_.size();
+    }
+    char peek() const {
+        return pattern_[pos_];
+    }
+    char take() {
+        if (at_end()) {
+            fail("Unexpected end of pattern");
+        }
+        return pattern_[pos_++];
+    }
+    size_t add(Node::Kind kind, std::vector<size_t> children = {}) {
+        Node node;
+        node.kind = kind;
+        node.children = std::move(children);
+        nodes_.push_back(std::move(node));
+        return nodes_.size() - 1;
+    }
+    size_t add_symbols(const SymbolSet &symbols) {
+        size_t i = add(Node::Kind::Symbols);
+        nodes_[i].symbols = symbols;
+        return i;
+    }
+    size_t parse_union() {
+        std::vector<size_t> alternatives = {parse_concat()};
+        while (!at_end() && peek() == '|') {
+            ++pos_;
+            alternatives.push_back(parse_concat());
+        }
+        return alternatives.size() == 1 ? alternatives[0] : add(Node::Kind::Union, alternatives);
+    }
+    size_t parse_concat() {
+        std::vector<size_t> items;
+        while (!at_end() && peek() != '|' && peek() != ')') {
+            items.push_back(parse_repeat());
+        }
+        if (items.empty()) {
+            return add(Node::Kind::Empty);
+        }
+        return items.size() == 1 ? items[0] : add(Node::Kind::Concat, items);
+    }
+    // Each repetition is a copy of the NFA of its atom, so counts are bounded
+    // as in RE2, which also keeps them far from overflowing int.
+    static constexpr int MaxRepeat = 1000;
+    int parse_number() {
+        if (at_end() || peek() < '0' || peek() > '9') {
+            fail("Not a number");
+        }
+        int n = 0;
+        while (!at_end() && peek() >= '0' && peek() <= '9') {
+            n = n * 10 + take() - '0';
+            if (n > MaxRepeat) {
+                fail("Repeat count is too large");
+            }
+        }
+        return n;
+    }
+    size_t parse_repeat() {
+        size_t atom = parse_atom();
+        while (!at_end()) {
+            char c = peek();
+            if (c == '*' || c == '+' || c == '?') {
+                ++pos_;
+                atom = add(c == '*' ? Node::Kind::Star : c == '+' ? Node::Kind::Plus : Node::Kind::Option, {atom});
+            } else if (c == '{') {
+                ++pos_;
+                size_t i = add(Node::Kind::Repeat, {atom});
+                nodes_[i].min = nodes_[i].max = parse_number();
+                if (!at_end() && peek() == ',') {
+                    ++pos_;
+                    nodes_[i].max = !at_end() && peek() == '}' ? -1 : parse_number();
+                }
+                if (take() != '}') {
+                    fail("Expected '}'");
+                }
+                if (nodes_[i].max != -1 && nodes_[i].max < nodes_[i].min) {
+                    fail("Repeat bounds are out of order");
+                }
+                atom = i;
+            } else {
+                break;
+            }
+        }
+        return atom;
+    }
+    // Returns the symbol of a plain or escaped character, where a plain ^ and $
+    // stand for BeginSymbol and EndSymbol.
+    int parse_symbol() {
+        char c = take();
+        if (c == '\\') {
+            return static_cast<unsigned char>(GetEscapeChar(take()));
+        }
+        if (c == '^') {
+            return BeginSymbol;
+        }
+        if (c == '$') {
+            return EndSymbol;
+        }
+        return static_cast<unsigned char>(c);
+    }
+    size_t parse_class() {
+        bool negated = !at_end() && peek() == '^';
+        if (negated) {
+            ++pos_;
+        }
+        SymbolSet symbols;
+        while (take() != ']') {
+            --pos_;
+            int from = parse_symbol();
+            if (!at_end() && peek() == '-') {
+                ++pos_;
+                int to = static_cast<unsigned char>(take());
+                for (int c = from; c <= to; ++c) {
+                    symbols.set(c);
+                }
+            } else {
+                symbols.set(from);
+            }
+        }
+        if (negated) {
+            SymbolSet bytes;
+            for (int c = 0; c < 256; ++c) {
+                bytes.set(c);
+            }
+            symbols = bytes & ~symbols;
+        }
+        return add_symbols(symbols);
+    }
+    // The name of \p{Name}, as a union of the sequences of byte ranges that
+    // encode its code points in UTF-8, see utf8.hpp.
+    size_t parse_property() {
+        size_t end = pattern_.find('}', pos_);
+        if (end == std::string_view::npos) {
+            fail("Expected '}'");
+        }
+        size_t index = unicode_property(pattern_.substr(pos_, end - pos_));
+        if (index == UnicodePropertiesCount) {
+            fail("Unknown Unicode property");
+        }
+        pos_ = end + 1;
+        const UnicodeProperty &property = UnicodeProperties[index];
+        Utf8Sequences<MaxUtf8Sequences> sequences = utf8_sequences(property.Ranges, property.Count);
+        std::vector<size_t> alternatives;
+        for (size_t i = 0; i < sequences.Size; ++i) {
+            const Utf8Sequence &sequence = sequences.Items[i];
+            std::vector<size_t> bytes;
+            for (size_t k = 0; k < sequence.Length; ++k) {
+                SymbolSet symbols;
+                for (int c = sequence.Low[k]; c <= sequence.High[k]; ++c) {
+                    symbols.set(c);
+                }
+                bytes.push_back(add_symbols(symbols));
+            }
+            alternatives.push_back(bytes.size() == 1 ? bytes[0] : add(Node::Kind::Concat, bytes));
+        }
+        return alternatives.size() == 1 ? alternatives[0] : add(Node::Kind::Union, alternatives);
+    }
+    size_t parse_atom() {
+        char c = peek();
+        if (c == '(') {
+            ++pos_;
+            size_t inner = parse_union();
+            if (at_end() || take() != ')') {
+                fail("Parentheses don't match!");
+            }
+            return inner;
+        }
+        if (c == '[') {
+            ++pos_;
+            return parse_class();
+        }
+        if (c == '*' || c == '+' || c == '?' || c == '{') {
+            fail("Nothing to repeat");
+        }
+        if (pattern_.substr(pos_, 3) == "\\p{") {
+            pos_ += 3;
+            return parse_property();
+        }
+        SymbolSet symbols;
+        symbols.set(parse_symbol());
+        return add_symbols(symbols);
+    }
+    std::string_view pattern_;
+    size_t pos_;
+    std::vector<Node> nodes_;
+};
+
+struct NFA {
+    struct Edge {
+        SymbolSet symbols;
+        int to;
+    };
+    struct State {
+        std::vector<Edge> edges;
+        std::vector<int> epsilon;
+    };
+    std::vector<State> states;
+    int start = 0;
+    int final = 0;
+};
+
+// Thompson construction, one fragment per node.
+class NFABuilder {
+public:
+    explicit NFABuilder(const std::vector<Node> &nodes) : nodes_(nodes) {}
+    NFA build(size_t root) {
+        auto [start, final] = fragment(root);
+        nfa_.start = start;
+        nfa_.final = final;
+        return std::move(nfa_);
+    }
+private:
+    int add_state() {
+        nfa_.states.emplace_back();
+        return nfa_.states.size() - 1;
+    }
+    void epsilon(int from, int to) {
+        nfa_.states[from].epsilon.push_back(to);
+    }
+    std::pair<int, int> fragment(size_t i) {
+        const Node &node = nodes_[i];
+        int start = add_state();
+        int final = add_state();
+        switch (node.kind) {
+            case Node::Kind::Symbols:
+                nfa_.states[start].edges.push_back({node.symbols, final});
+                break;
+            case Node::Kind::Empty:
+                epsilon(start, final);
+                break;
+            case Node::Kind::Concat: {
+                int last = start;
+                for (size_t child : node.children) {
+                    auto [s, f] = fragment(child);
+                    epsilon(last, s);
+                    last = f;
+                }
+                epsilon(last, final);
+                break;
+            }
+            case Node::Kind::Union:
+                for (size_t child : node.children) {
+                    auto [s, f] = fragment(child);
+                    epsilon(start, s);
+                    epsilon(f, final);
+                }
+                break;
+            case Node::Kind::Star:
+            case Node::Kind::Plus:
+            case Node::Kind::Option: {
+                auto [s, f] = fragment(node.children[0]);
+                epsilon(start, s);
+                epsilon(f, final);
+                if (node.kind != Node::Kind::Plus) {
+                    epsilon(start, final);
+                }
+                if (node.kind != Node::Kind::Option) {
+                    epsilon(f, s);
+                }
+                break;
+            }
+            case Node::Kind::Repeat: {
+                int last = start;
+                for (int k = 0; k < node.min; ++k) {
+                    auto [s, f] = fragment(node.children[0]);
+                    epsilon(last, s);
+                    last = f;
+                }
+                if (node.max == -1) {
+                    auto [s, f] = fragment(node.children[0]);
+                    epsilon(last, s);
+                    epsilon(f, s);
+                    epsilon(f, final);
+                } else {
+                    for (int k = node.min; k < node.max; ++k) {
+                        auto [s, f] = fragment(node.children[0]);
+                        epsilon(last, s);
+                        epsilon(last, final);
+                        last = f;
+                    }
+                }
+                epsilon(last, final);
+                break;
+            }
+        }
+        return {start, final};
+    }
+    const std::vector<Node> &nodes_;
+    NFA nfa_;
+};
+
+// The executable form, laid out like PackedDFA.
+struct Automaton {
+    std::vector<uint32_t> table;
+    ByteClassMap byte_classes;
+    size_t stride = 0;
+    size_t begin_class = 0;
+    size_t end_class = 0;
+    uint32_t start_state = 0;
+    uint32_t final_states = 0;
+    static constexpr uint32_t DeadState = 0;
+    uint32_t next(uint32_t state, unsigned char c) const {
+        return table[state + byte_classes[c]];
+    }
+    bool is_final(uint32_t state) const {
+        return state >= final_states;
+    }
+};
+
+// Symbols that no edge tells apart share a class, as in CompressDFA.
+inline std::vector<int> symbol_classes(const NFA &nfa, size_t &count) {
+    std::vector<int> classes(EndSymbol + 1, 0);
+    count = 1;
+    for (const NFA::State &state : nfa.states) {
+        for (const NFA::Edge &edge : state.edges) {
+            std::map<std::pair<int, bool>, int> split;
+            for (int c = 0; c <= EndSymbol; ++c) {
+                auto key = std::make_pair(classes[c], bool(edge.symbols[c]));
+                auto it = split.emplace(key, split.size()).first;
+                classes[c] = it->second;
+            }
+            count = split.size();
+        }
+    }
+    return classes;
+}
+
+inline void epsilon_closure(const NFA &nfa, std::vector<int> &states) {
+    std::vector<bool> seen(nfa.states.size());
+    for (int s : states) {
+        seen[s] = true;
+    }
+    for (size_t i = 0; i < states.size(); ++i) {
+        for (int t : nfa.states[states[i]].epsilon) {
+            if (!seen[t]) {
+                seen[t] = true;
+                states.push_back(t);
+            }
+        }
+    }
+    std::sort(states.begin(), states.end());
+}
+
+inline Automaton compile(const NFA &nfa) {
+    size_t columns = 0;
+    std::vector<int> classes = symbol_classes(nfa, columns);
+    std::vector<int> representatives(columns);
+    for (int c = EndSymbol; c >= 0; --c) {
+        representatives[classes[c]] = c;
+    }
+    // Subset construction, -1 being the dead state.
+    std::map<std::vector<int>, int> ids;
+    std::vector<std::vector<int>> subsets;
+    std::vector<std::vector<int>> dfa;
+    std::vector<bool> finals;
+    auto find_or_add = [&](std::vector<int> subset) {
+        if (subset.empty()) {
+            return -1;
+        }
+        epsilon_closure(nfa, subset);
+        auto [it, added] = ids.emplace(subset, subsets.size());
+        if (added) {
+            subsets.push_back(subset);
+        }
+        return it->second;
+    };
+    find_or_add({nfa.start});
+    for (size_t i = 0; i < subsets.size(); ++i) {
+        std::vector<int> row(columns);
+        for (size_t c = 0; c < columns; ++c) {
+            std::vector<int> moved;
+            for (int s : subsets[i]) {
+                for (const NFA::Edge &edge : nfa.states[s].edges) {
+                    if (edge.symbols[representatives[c]]) {
+                        moved.push_back(edge.to);
+                    }
+                }
+            }
+            std::sort(moved.begin(), moved.end());
+            moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+            row[c] = find_or_add(moved);
+        }
+        dfa.push_back(row);
+        finals.push_back(std::binary_search(subsets[i].begin(), subsets[i].end(), nfa.final));
+    }
+    // Moore refinement with the dead state as an extra state, so that states
+    // from which no final state can be reached fall into its block.
+    size_t states = dfa.size() + 1;
+    size_t dead = dfa.size();
+    auto target = [&](size_t s, size_t c) {
+        return s == dead || dfa[s][c] == -1 ? dead : size_t(dfa[s][c]);
+    };
+    std::vector<size_t> block(states);
+    for (size_t s = 0; s < dfa.size(); ++s) {
+        block[s] = finals[s];
+    }
+    block[dead] = 0;
+    for (size_t blocks = 0; ; ) {
+        std::map<std::vector<size_t>, size_t> signatures;
+        std::vector<size_t> next(states);
+        for (size_t s = 0; s < states; ++s) {
+            std::vector<size_t> signature = {block[s]};
+            for (size_t c = 0; c < columns; ++c) {
+                signature.push_back(block[target(s, c)]);
+            }
+            next[s] = signatures.emplace(signature, signatures.size()).first->second;
+        }
+        block = next;
+        if (signatures.size() == blocks) {
+            break;
+        }
+        blocks = signatures.size();
+    }
+    // Rows: the dead block first, then the other non-final blocks, then the final ones.
+    std::vector<int> rows(states, -1);
+    size_t row = 0;
+    rows[block[dead]] = row++;
+    for (int final = 0; final < 2; ++final) {
+        for (size_t s = 0; s < dfa.size(); ++s) {
+            if (finals[s] == bool(final) && rows[block[s]] == -1) {
+                rows[block[s]] = row++;
+            }
+        }
+    }
+    Automaton result;
+    result.stride = columns;
+    result.table.assign(row * columns, 0);
+    size_t final_rows = 0;
+    std::vector<bool> done(row);
+    for (size_t s = 0; s < dfa.size(); ++s) {
+        size_t r = rows[block[s]];
+        if (done[r]) {
+            continue;
+        }
+        done[r] = true;
+        final_rows += finals[s];
+        for (size_t c = 0; c < columns; ++c) {
+            result.table[r * columns + c] = rows[block[target(s, c)]] * columns;
+        }
+    }
+    result.final_states = (row - final_rows) * columns;
+    result.start_state = rows[block[0]] * columns;
+    for (int c = 0; c < 256; ++c) {
+        result.byte_classes[c] = classes[c];
+    }
+    result.begin_class = classes[BeginSymbol];
+    result.end_class = classes[EndSymbol];
+    return result;
+}
+}
+
+// A regex compiled at run time, with the interface of Regex. The constructor
+// throws std::invalid_argument if the pattern is malformed.
+class RuntimeRegex {
+public:
+    explicit RuntimeRegex(std::string_view pattern) {
+        size_t root = 0;
+        std::vector<Runtime::Node> nodes = Runtime::Parser(pattern).parse(root);
+        dfa_ = Runtime::compile(Runtime::NFABuilder(nodes).build(root));
+        // Matches any input that ends with a match, as Regex::SearchDFA::Forward.
+        Runtime::SymbolSet begin, bytes;
+        begin.set(BeginSymbol);
+        for (int c = 0; c < 256; ++c) {
+            bytes.set(c);
+        }
+        Runtime::Node option_begin;
+        option_begin.kind = Runtime::Node::Kind::Symbols;
+        option_begin.symbols = begin;
+        nodes.push_back(option_begin);
+        nodes.push_back({Runtime::Node::Kind::Option, {}, {nodes.size() - 1}});
+        size_t prefix = nodes.size() - 1;
+        Runtime::Node any;
+        any.kind = Runtime::Node::Kind::Symbols;
+        any.symbols = bytes;
+        nodes.push_back(any);
+        nodes.push_back({Runtime::Node::Kind::Star, {}, {nodes.size() - 1}});
+        nodes.push_back({Runtime::Node::Kind::Concat, {}, {prefix, nodes.size() - 1, root}});
+        forward_ = Runtime::compile(Runtime::NFABuilder(nodes).build(nodes.size() - 1));
+        // R between optional BeginSymbol and EndSymbol, as Regex::SearchDFA::Anchored.
+        Runtime::SymbolSet end;
+        end.set(EndSymbol);
+        Runtime::Node option_end;
+        option_end.kind = Runtime::Node::Kind::Symbols;
+        option_end.symbols = end;
+        nodes.push_back(option_end);
+        nodes.push_back({Runtime::Node::Kind::Option, {}, {nodes.size() - 1}});
+        nodes.push_back({Runtime::Node::Kind::Concat, {}, {prefix, root, nodes.size() - 1}});
+        anchored_ = Runtime::compile(Runtime::NFABuilder(nodes).build(nodes.size() - 1));
+    }
+    bool match(const std::string &str) const {
+        return match(str.data(), str.length());
+    }
+    bool match(const char *str, size_t length) const {
+        uint32_t state = dfa_.table[dfa_.start_state + dfa_.begin_class];
+        for (size_t i = 0; i < length; ++i) {
+            if (state == dfa_.DeadState) {
+                return false;
+            }
+            state = dfa_.next(state, str[i]);
+        }
+        return dfa_.is_final(dfa_.table[state + dfa_.end_class]);
+    }
+    bool match(const char *str) const {
+        return match(str, std::char_traits<char>::length(str));
+    }
+    // Returns whether any substring of str matches, as Regex::search.
+    bool search(const std::string &str) const {
+        return search(str.data(), str.length());
+    }
+    bool search(const char *str, size_t length) const {
+        uint32_t state = forward_.table[forward_.start_state + forward_.begin_class];
+        for (size_t i = 0; i < length; ++i) {
+            if (forward_.is_final(state)) {
+                return true;
+            }
+            if (state == forward_.DeadState) {
+                return false;
+            }
+            state = forward_.next(state, str[i]);
+        }
+        return forward_.is_final(state) || forward_.is_final(forward_.table[state + forward_.end_class]);
+    }
+    bool search(const char *str) const {
+        return search(str, std::char_traits<char>::length(str));
+    }
+    // Returns the length of the longest prefix of str that matches, or
+    // std::string_view::npos, as Regex::match_prefix.
+    size_t match_prefix(const std::string &str) const {
+        return match_prefix(str.data(), str.length());
+    }
+    size_t match_prefix(const char *str, size_t length) const {
+        return prefix(str, length, false);
+    }
+    size_t match_prefix(const char *str) const {
+        return match_prefix(str, std::char_traits<char>::length(str));
+    }
+    // Returns the length of the shortest prefix of str that matches, or npos.
+    size_t first_accept(const std::string &str) const {
+        return first_accept(str.data(), str.length());
+    }
+    size_t first_accept(const char *str, size_t length) const {
+        return prefix(str, length, true);
+    }
+    size_t first_accept(const char *str) const {
+        return first_accept(str, std::char_traits<char>::length(str));
+    }
+    // The same over binary buffers, see ByteInput.
+    template <typename B, typename = ByteInput<B>>
+    bool match(const B *data, size_t length) const {
+        return match(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    bool search(const B *data, size_t length) const {
+        return search(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    size_t match_prefix(const B *data, size_t length) const {
+        return match_prefix(byte_chars(data), length);
+    }
+    template <typename B, typename = ByteInput<B>>
+    size_t first_accept(const B *data, size_t length) const {
+        return first_accept(byte_chars(data), length);
+    }
+private:
+    size_t prefix(const char *str, size_t length, bool first) const {
+        uint32_t state = anchored_.table[anchored_.start_state + anchored_.begin_class];
+        size_t end = std::string_view::npos;
+        size_t i = 0;
+        for (; ; ++i) {
+            if (anchored_.is_final(state)) {
+                end = i;
+                if (first) {
+                    return end;
+                }
+            }
+            if (i == length || state == anchored_.DeadState) {
+                break;
+            }
+            state = anchored_.next(state, str[i]);
+        }
+        if (i == length && end != length && anchored_.is_final(anchored_.table[state + anchored_.end_class])) {
+            end = length;
+        }
+        return end;
+    }
+    Runtime::Automaton dfa_;
+    Runtime::Automaton forward_;
+    Runtime::Automaton anchored_;
+};
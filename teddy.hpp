@@ -0,0 +1,143 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#include "util.hpp"
+
+// Candidate finder for a small set of literals, in the style of Teddy from
+// Hyperscan. Every literal gets a bucket bit. For each of the first N bytes of
+// the literals there are two 16-entry tables that map the low and the high
+// nibble of an input byte to the buckets that allow it there, so with pshufb a
+// whole vector of positions is tested in a few instructions. Nibble tables give
+// false positives, which are filtered out with exact 256-entry tables, and the
+// DFA still verifies every candidate.
+template <size_t N>
+struct TeddyMasks {
+    ConstexprArray<ConstexprArray<unsigned char, 16>, N> Low;
+    ConstexprArray<ConstexprArray<unsigned char, 16>, N> High;
+    ConstexprArray<ConstexprArray<unsigned char, 256>, N> Exact;
+};
+
+// Builds the masks from the first N bytes of each literal.
+template <size_t N, size_t L, size_t M>
+constexpr TeddyMasks<N> BuildTeddyMasks(const ConstexprArray<ConstexprArray<unsigned char, L>, M> &Literals, size_t Count) {
+    static_assert(N <= L, "literals are shorter than the fingerprint");
+    static_assert(M <= 8, "Teddy has 8 buckets");
+    TeddyMasks<N> Masks;
+    for (size_t i = 0; i < Count; ++i) {
+        unsigned char Bucket = 1 << i;
+        for (size_t j = 0; j < N; ++j) {
+            unsigned char c = Literals[i][j];
+            Masks.Low[j][c & 0xf] |= Bucket;
+            Masks.High[j][c >> 4] |= Bucket;
+            Masks.Exact[j][c] |= Bucket;
+        }
+    }
+    return Masks;
+}
+
+template <size_t N>
+constexpr bool teddy_verify(const TeddyMasks<N> &Masks, const char *str, size_t i) {
+    unsigned char Buckets = 0xff;
+    for (size_t j = 0; j < N; ++j) {
+        Buckets &= Masks.Exact[j][static_cast<unsigned char>(str[i + j])];
+    }
+    return Buckets != 0;
+}
+
+template <size_t N>
+constexpr size_t teddy_find_scalar(const TeddyMasks<N> &Masks, const char *str, size_t length, size_t from) {
+    for (size_t i = from; i + N <= length; ++i) {
+        if (teddy_verify(Masks, str, i)) {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+template <size_t N>
+__attribute__((target("ssse3")))
+size_t teddy_find_ssse3(const TeddyMasks<N> &Masks, const char *str, size_t length, size_t from) {
+    const __m128i Nibble = _mm_set1_epi8(0xf);
+    const __m128i Zero = _mm_setzero_si128();
+    __m128i Low[N], High[N];
+    for (size_t j = 0; j < N; ++j) {
+        Low[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Masks.Low[j].data()));
+        High[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(Masks.High[j].data()));
+    }
+    size_t i = from;
+    for (; i + 16 + N - 1 <= length; i += 16) {
+        __m128i Buckets = _mm_set1_epi8(-1);
+        for (size_t j = 0; j < N; ++j) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(str + i + j));
+            __m128i l = _mm_shuffle_epi8(Low[j], _mm_and_si128(v, Nibble));
+            __m128i h = _mm_shuffle_epi8(High[j], _mm_and_si128(_mm_srli_epi16(v, 4), Nibble));
+            Buckets = _mm_and_si128(Buckets, _mm_and_si128(l, h));
+        }
+        unsigned Candidates = _mm_movemask_epi8(_mm_cmpeq_epi8(Buckets, Zero)) ^ 0xffff;
+        for (; Candidates; Candidates &= Candidates - 1) {
+            size_t k = i + __builtin_ctz(Candidates);
+            if (teddy_verify(Masks, str, k)) {
+                return k;
+            }
+        }
+    }
+    return teddy_find_scalar(Masks, str, length, i);
+}
+
+template <size_t N>
+__attribute__((target("avx2")))
+size_t teddy_find_avx2(const TeddyMasks<N> &Masks, const char *str, size_t length, size_t from) {
+    const __m256i Nibble = _mm256_set1_epi8(0xf);
+    const __m256i Zero = _mm256_setzero_si256();
+    __m256i Low[N], High[N];
+    for (size_t j = 0; j < N; ++j) {
+        Low[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(Masks.Low[j].data())));
+        High[j] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(Masks.High[j].data())));
+    }
+    size_t i = from;
+    for (; i + 32 + N - 1 <= length; i += 32) {
+        __m256i Buckets = _mm256_set1_epi8(-1);
+        for (size_t j = 0; j < N; ++j) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(str + i + j));
+            __m256i l = _mm256_shuffle_epi8(Low[j], _mm256_and_si256(v, Nibble));
+            __m256i h = _mm256_shuffle_epi8(High[j], _mm256_and_si256(_mm256_srli_epi16(v, 4), Nibble));
+            Buckets = _mm256_and_si256(Buckets, _mm256_and_si256(l, h));
+        }
+        unsigned Candidates = ~static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(Buckets, Zero)));
+        for (; Candidates; Candidates &= Candidates - 1) {
+            size_t k = i + __builtin_ctz(Candidates);
+            if (teddy_verify(Masks, str, k)) {
+                return k;
+            }
+        }
+    }
+    return teddy_find_ssse3(Masks, str, length, i);
+}
+#endif
+
+template <size_t N>
+size_t teddy_find_runtime(const TeddyMasks<N> &Masks, const char *str, size_t length, size_t from) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx2")) {
+        return teddy_find_avx2(Masks, str, length, from);
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return teddy_find_ssse3(Masks, str, length, from);
+    }
+#endif
+    return teddy_find_scalar(Masks, str, length, from);
+}
+
+// Returns the first position at or after from where one of the literals starts
+// with its N fingerprint bytes, or npos.
+template <size_t N>
+constexpr size_t teddy_find(const TeddyMasks<N> &Masks, const char *str, size_t length, size_t from) {
+    if (__builtin_is_constant_evaluated()) {
+        return teddy_find_scalar(Masks, str, length, from);
+    }
+    return teddy_find_runtime(Masks, str, length, from);
+}
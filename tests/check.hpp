@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdio>
+#include <string>
+
+// Shared by the tests: every failed check is printed and counted, and main
+// returns report() so that tests/run.py sees the failure.
+inline int Failures = 0;
+
+inline void fail(const char *file, int line, const std::string &what) {
+    ++Failures;
+    if (Failures <= 20) {
+        std::printf("%s:%d: %s\n", file, line, what.c_str());
+    }
+}
+
+#define CHECK(condition) \
+    ((condition) ? (void)0 : fail(__FILE__, __LINE__, "CHECK(" #condition ") failed"))
+
+#define CHECK_EQ(actual, expected) \
+    ((actual) == (expected) ? (void)0 : fail(__FILE__, __LINE__, \
+        "CHECK_EQ(" #actual ", " #expected "): " + std::to_string(actual) + " != " + std::to_string(expected)))
+
+inline int report(const char *name) {
+    std::printf("%s: %s, %d failures\n", name, Failures == 0 ? "ok" : "FAILED", Failures);
+    return Failures == 0 ? 0 : 1;
+}
+
+// Calls f with every string over alphabet of at most max_length bytes, shortest first.
+template <typename F>
+void for_each_string(const std::string &alphabet, size_t max_length, F f) {
+    std::string input;
+    f(input);
+    for (size_t length = 1; length <= max_length; ++length) {
+        input.assign(length, alphabet[0]);
+        std::string digits(length, 0);
+        while (true) {
+            f(input);
+            size_t i = length;
+            while (i > 0 && digits[i - 1] + 1 == static_cast<char>(alphabet.size())) {
+                digits[i - 1] = 0;
+                input[i - 1] = alphabet[0];
+                --i;
+            }
+            if (i == 0) {
+                break;
+            }
+            ++digits[i - 1];
+            input[i - 1] = alphabet[digits[i - 1]];
+        }
+    }
+}
@@ -0,0 +1,345 @@
+// Every engine against a brute-force std::regex oracle: match, search,
+// match_prefix, first_accept and find, on every string over a small alphabet,
+// for each operation the engine has, over char, unsigned char and std::byte.
+// ^ and $ only match at the ends of the whole input, and match reads them as
+// symbols of their own, see symbols.
+#include <cstddef>
+#include <random>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "regex.hpp"
+#include "parser.hpp"
+#include "runtime.hpp"
+#include "check.hpp"
+
+namespace {
+
+bool matches_span(const std::regex &pattern, const std::string &input, size_t begin, size_t end) {
+    auto flags = std::regex_constants::match_default;
+    if (begin != 0) {
+        flags |= std::regex_constants::match_not_bol;
+    }
+    if (end != input.size()) {
+        flags |= std::regex_constants::match_not_eol;
+    }
+    return std::regex_match(input.begin() + begin, input.begin() + end, pattern, flags);
+}
+
+// match runs the pattern over BeginSymbol, the input and EndSymbol, so a pattern
+// only matches if it reads each of them where it is. That is std::regex_match
+// of "<" + input + ">" against the pattern with ^ and $ spelled < and >, and
+// with negated classes kept off them.
+std::string symbols(const char *source) {
+    std::string result;
+    for (const char *c = source; *c; ++c) {
+        if (*c == '^' && c != source && c[-1] == '[') {
+            result += "^<>";
+        } else if (*c == '^' || *c == '$') {
+            result += *c == '^' ? '<' : '>';
+        } else {
+            result += *c;
+        }
+    }
+    return result;
+}
+
+// What each operation should give on one input.
+struct Expected {
+    bool match = false;
+    size_t match_prefix = std::string_view::npos;
+    size_t first_accept = std::string_view::npos;
+    bool search = false;
+    MatchSpan find;
+};
+
+Expected oracle(const std::regex &pattern, const std::regex &whole, const std::string &input) {
+    Expected result;
+    result.match = std::regex_match("<" + input + ">", whole);
+    for (size_t end = 0; end <= input.size(); ++end) {
+        if (matches_span(pattern, input, 0, end)) {
+            if (result.first_accept == std::string_view::npos) {
+                result.first_accept = end;
+            }
+            result.match_prefix = end;
+        }
+    }
+    // Trying every begin is cubic, so long inputs take theirs from
+    // std::regex_search, which also starts at the leftmost begin.
+    size_t first = 0;
+    size_t last = input.size();
+    std::smatch found;
+    if (input.size() > 20) {
+        if (!std::regex_search(input, found, pattern)) {
+            return result;
+        }
+        first = last = found.position(0);
+    }
+    for (size_t begin = first; begin <= last && !result.find; ++begin) {
+        for (size_t end = input.size() + 1; end-- > begin; ) {
+            if (matches_span(pattern, input, begin, end)) {
+                result.find = MatchSpan(begin, end);
+                break;
+            }
+        }
+    }
+    result.search = static_cast<bool>(result.find);
+    return result;
+}
+
+std::string describe(size_t length) {
+    return length == std::string_view::npos ? "npos" : std::to_string(length);
+}
+
+std::string describe(MatchSpan span) {
+    return span ? "[" + std::to_string(span.begin) + "," + std::to_string(span.end) + ")" : "none";
+}
+
+std::string describe(bool value) {
+    return value ? "true" : "false";
+}
+
+// Bytes outside printable ASCII are shown as \x escapes.
+std::string printable(const std::string &input) {
+    std::string result;
+    for (unsigned char c : input) {
+        if (c < 0x20 || c >= 0x7f) {
+            const char digits[] = "0123456789abcdef";
+            result += std::string("\\x") + digits[c >> 4] + digits[c & 0xf];
+        } else {
+            result += static_cast<char>(c);
+        }
+    }
+    return result;
+}
+
+// Only some engines search or find, and not all of them over every B.
+template <typename E, typename B, typename = void>
+struct HasSearch : std::false_type {};
+template <typename E, typename B>
+struct HasSearch<E, B, std::void_t<decltype(std::declval<const E &>().search(std::declval<const B *>(), 0))>> : std::true_type {};
+template <typename E, typename B, typename = void>
+struct HasFind : std::false_type {};
+template <typename E, typename B>
+struct HasFind<E, B, std::void_t<decltype(std::declval<const E &>().find(std::declval<const B *>(), 0))>> : std::true_type {};
+
+// E is a Regex type or RuntimeRegex. Operations are called on an object of it,
+// which for a Regex type calls the static function.
+template <typename E>
+class Checker {
+public:
+    Checker(const char *engine, const char *source, const E &regex) : engine_(engine), source_(source), regex_(regex) {}
+    void operator()(const std::string &input, const Expected &expected) const {
+        check(input, expected, "", input.data());
+        check(input, expected, " over unsigned char", reinterpret_cast<const unsigned char *>(input.data()));
+        check(input, expected, " over std::byte", reinterpret_cast<const std::byte *>(input.data()));
+    }
+private:
+    template <typename B>
+    void check(const std::string &input, const Expected &expected, const char *over, const B *str) const {
+        size_t length = input.size();
+        compare(input, over, "match", regex_.match(str, length), expected.match);
+        compare(input, over, "match_prefix", regex_.match_prefix(str, length), expected.match_prefix);
+        compare(input, over, "first_accept", regex_.first_accept(str, length), expected.first_accept);
+        if constexpr (HasSearch<E, B>::value) {
+            compare(input, over, "search", regex_.search(str, length), expected.search);
+        }
+        if constexpr (HasFind<E, B>::value) {
+            compare(input, over, "find", regex_.find(str, length), expected.find);
+        }
+    }
+    template <typename T>
+    void compare(const std::string &input, const char *over, const char *operation, T actual, T expected) const {
+        if (describe(actual) != describe(expected)) {
+            fail(__FILE__, __LINE__, std::string(engine_) + " " + printable(source_) + " on \"" + printable(input) +
+                "\": " + operation + over + " gives " + describe(actual) + ", expected " + describe(expected));
+        }
+    }
+    const char *engine_;
+    const char *source_;
+    const E &regex_;
+};
+
+// LazyDFAEngine<3> has room for one state besides the dead and start states,
+// so it flushes its cache on almost every step.
+template <typename R>
+struct Engines {
+    explicit Engines(const char *source_) : source(source_), runtime(source_), pattern(source_), whole(symbols(source_)) {}
+    void check(const std::string &input) const {
+        Expected expected = oracle(pattern, whole, input);
+        Checker("DFAEngine", source, dfa)(input, expected);
+        Checker("BitParallelEngine", source, bit_parallel)(input, expected);
+        Checker("LazyDFAEngine<>", source, lazy)(input, expected);
+        Checker("LazyDFAEngine<3>", source, lazy_flushed)(input, expected);
+        Checker("DirectCodedEngine", source, direct_coded)(input, expected);
+        Checker("CountingEngine", source, counting)(input, expected);
+        Checker("RuntimeRegex", source, runtime)(input, expected);
+    }
+    const char *source;
+    Regex<R, DFAEngine> dfa;
+    Regex<R, BitParallelEngine> bit_parallel;
+    Regex<R, LazyDFAEngine<>> lazy;
+    Regex<R, LazyDFAEngine<3>> lazy_flushed;
+    Regex<R, DirectCodedEngine> direct_coded;
+    Regex<R, CountingEngine> counting;
+    RuntimeRegex runtime;
+    std::regex pattern;
+    std::regex whole;
+};
+
+// For counts too large to unroll into a DFA at compile time. With bounds past
+// 64 the counters' rings span several words, and inputs longer than Max make
+// CountingEngine drop entries from them and look for the next one.
+template <typename R>
+struct LargeCounts {
+    explicit LargeCounts(const char *source_) : source(source_), runtime(source_), pattern(source_), whole(symbols(source_)) {}
+    void check(const std::string &input) const {
+        Expected expected = oracle(pattern, whole, input);
+        Checker("CountingEngine", source, counting)(input, expected);
+        Checker("RuntimeRegex", source, runtime)(input, expected);
+    }
+    const char *source;
+    Regex<R, CountingEngine> counting;
+    RuntimeRegex runtime;
+    std::regex pattern;
+    std::regex whole;
+};
+
+template <typename R>
+void check_engines(const char *source, const std::string &alphabet, size_t max_length) {
+    Engines<R> engines(source);
+    for_each_string(alphabet, max_length, [&](const std::string &input) {
+        engines.check(input);
+    });
+}
+
+// Inputs of 100 to 400 bytes made of pieces, half of them with one byte
+// changed, so that most of them run long before they match or die.
+template <typename R, template <typename> class E = Engines>
+void check_long(const char *source, const std::string &alphabet, std::initializer_list<const char *> pieces) {
+    E<R> engines(source);
+    std::vector<std::string> choices(pieces.begin(), pieces.end());
+    std::mt19937 random(11);
+    for (int round = 0; round < 200; ++round) {
+        std::string input;
+        for (size_t length = 100 + random() % 301; input.size() < length; ) {
+            input += choices[random() % choices.size()];
+        }
+        if (random() % 2 == 0) {
+            input[random() % input.size()] = alphabet[random() % alphabet.size()];
+        }
+        engines.check(input);
+    }
+}
+
+// Every transition of a DFA that runs sparse against its dense Table, dead
+// state included.
+template <typename D>
+void check_sparse(const char *source, const char *form) {
+    static_assert(D::Sparse, "");
+    for (size_t state = 0; state <= D::MaxState; state += D::Stride) {
+        for (size_t c = 0; c < D::Stride; ++c) {
+            if (D::transition(state, c) != D::Table[state + c]) {
+                fail(__FILE__, __LINE__, std::string(form) + " of " + source + ": transition(" +
+                    std::to_string(state) + ", " + std::to_string(c) + ") is not Table[" + std::to_string(state + c) + "]");
+            }
+        }
+    }
+}
+
+// The automata Regex builds for R, spelled out as they are in SearchDFA.
+template <typename R>
+void check_sparse_forms(const char *source) {
+    check_sparse<CompileRegex<R>>(source, "DFA");
+    check_sparse<CompileRegex<Concat<Option<Begin>, Star<Any>, R>>>(source, "Forward");
+    check_sparse<CompileRegex<Concat<Option<End>, typename R::Reversed, Option<Begin>>>>(source, "Reverse");
+    check_sparse<CompileRegex<Concat<Option<Begin>, R, Option<End>>>>(source, "Anchored");
+}
+
+// The word itself, each of its proper prefixes and each one-byte change of it.
+template <typename R>
+void check_edits(const char *source, const std::string &word, char other) {
+    Engines<R> engines(source);
+    engines.check(word);
+    for (size_t i = 0; i < word.size(); ++i) {
+        engines.check(word.substr(0, i));
+        std::string changed = word;
+        changed[i] = other;
+        engines.check(changed);
+    }
+}
+
+#define CHECK_ENGINES(pattern, alphabet, max_length) \
+    check_engines<PatternOf<REGEX(pattern)>::Type>(pattern, alphabet, max_length)
+#define CHECK_LONG(pattern, alphabet, ...) \
+    check_long<PatternOf<REGEX(pattern)>::Type>(pattern, alphabet, {__VA_ARGS__})
+// REGEX would build the DFA of these, so they are spelled as ASTs, with the
+// source they are parsed from for std::regex.
+#define CHECK_LARGE_COUNTS(Pattern, pattern, alphabet, ...) \
+    check_long<Pattern, LargeCounts>(pattern, alphabet, {__VA_ARGS__})
+#define CHECK_EDITS(pattern, word, other) \
+    check_edits<PatternOf<REGEX(pattern)>::Type>(pattern, word, other)
+#define CHECK_SPARSE(pattern) \
+    check_sparse_forms<PatternOf<REGEX(pattern)>::Type>(pattern)
+
+// Long enough that every automaton of it is run from a comb vector.
+#define LETTERS "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWX"
+
+// Pieces long enough that runs of [ab] often pass 64 and 130 bytes.
+#define AB40 "abababababababababababababababababababab"
+#define B33 "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"
+
+// DirectCodedEngine pauses every few dozen transitions, in constant evaluation too.
+constexpr char Alternating[] = "abababababababababababababababababababababababababababababababab"
+    "ababababababababababababababababababababababababababababababababababababab";
+static_assert(REGEX("^(ab)*$")::match(Alternating), "");
+static_assert(Regex<PatternOf<REGEX("^(ab)*$")>::Type, DirectCodedEngine>::match(Alternating), "");
+static_assert(Regex<PatternOf<REGEX("(ab)*")>::Type, DirectCodedEngine>::match_prefix(Alternating) == sizeof(Alternating) - 1, "");
+
+}
+
+int main() {
+    CHECK_ENGINES("abcd|c", "abcd", 6);
+    CHECK_ENGINES("ab|b|bcd", "abcd", 6);
+    CHECK_ENGINES("a(b|c)*d|b|cd", "abcd", 6);
+    CHECK_ENGINES("a+b|a", "ab", 9);
+    CHECK_ENGINES("(ab)*", "ab", 9);
+    CHECK_ENGINES("b*", "ab", 8);
+    CHECK_ENGINES("a?b?", "ab", 8);
+    CHECK_ENGINES("a[ab]{2}|b", "ab", 9);
+    CHECK_ENGINES("(a|b){2,4}c", "abc", 7);
+    CHECK_ENGINES("a{3}", "ab", 8);
+    CHECK_ENGINES("^ab|b", "ab", 8);
+    CHECK_ENGINES("ab$|b|aba", "ab", 8);
+    CHECK_ENGINES("^(a|b)*$", "abc", 6);
+    CHECK_ENGINES("^(ab|a)(c|bc)$|^b", "abc", 6);
+    CHECK_ENGINES("^a[^b]c$|b$", "abc", 6);
+    CHECK_ENGINES("[^a]b", "abc", 6);
+    CHECK_ENGINES("[^ab]+|[^a-b]a|b", "abcd", 5);
+    CHECK_ENGINES("c(a|b)*c|a", "abc", 6);
+    // Bytes above 0x7f are negative as char but must match as themselves.
+    CHECK_ENGINES("\xff\x80+", "\x80\xff\x7f", 6);
+    CHECK_ENGINES("^\x80[^\xff]|\xff$|[\x7f\xfe]\x80", "\x80\xff\x7f\xfe", 5);
+
+    CHECK_LONG("^(ab|a)*$", "ab", "ab", "a");
+    CHECK_LONG("(ab|a)*c|b+", "abc", "ab", "a", "c", "b");
+    CHECK_LONG("^([0-9]+x)*[0-9]*$", "0x", "1", "23", "x", "456x");
+    CHECK_LONG("a(b|c)*d", "abcd", "ab", "c", "cb", "d");
+    CHECK_LONG("\xff\x80+", "\x80\xff\x7f", "\xff", "\x80\x80", "\x7f");
+
+    using AB = CharClass<'a', 'b'>;
+    using UpTo200 = Concat<Begin, Repeat<AB, 1, 200>, End>;
+    CHECK_LARGE_COUNTS(UpTo200, "^[ab]{1,200}$", "abc", "a", "b", "ab", "bbbbbbbbbb");
+    using Between = Concat<Repeat<AB, 70, 130>, Char<'c'>>;
+    CHECK_LARGE_COUNTS(Between, "[ab]{70,130}c", "abc", AB40, B33, "a", "c");
+    using Either = Union<Concat<Char<'x'>, Repeat<AB, 70, 130>, Char<'y'>>, Concat<Begin, Repeat<Digit, 1, 200>>>;
+    CHECK_LARGE_COUNTS(Either, "x[ab]{70,130}y|^[0-9]{1,200}", "abxy0", "x", "y", AB40, B33,
+        "01234567890123456789012345678901234567890123456789");
+
+    CHECK_SPARSE(LETTERS);
+    CHECK_SPARSE("^" LETTERS "$");
+    CHECK_LONG(LETTERS, "aAXz0", LETTERS, "abcdefghijklmnopqrstuvwxyz", "ABCDEFGHIJKLMNOPQRSTUVWX", "ab", "0");
+    CHECK_EDITS("^" LETTERS "$", LETTERS, '0');
+    return report("engines");
+}
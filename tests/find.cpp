@@ -0,0 +1,130 @@
+// Regex::find and find_all against a brute-force leftmost-longest search: the
+// span with the smallest begin, and the largest end from there, such that
+// std::regex matches exactly that span. ^ and $ only match at the ends of the
+// whole input.
+#include <regex>
+#include <string>
+#include "regex.hpp"
+#include "parser.hpp"
+#include "check.hpp"
+
+namespace {
+
+bool matches_span(const std::regex &pattern, const std::string &input, size_t begin, size_t end) {
+    auto flags = std::regex_constants::match_default;
+    if (begin != 0) {
+        flags |= std::regex_constants::match_not_bol;
+    }
+    if (end != input.size()) {
+        flags |= std::regex_constants::match_not_eol;
+    }
+    return std::regex_match(input.begin() + begin, input.begin() + end, pattern, flags);
+}
+
+// The leftmost-longest match that begins at from or later.
+MatchSpan oracle(const std::regex &pattern, const std::string &input, size_t from) {
+    for (size_t begin = from; begin <= input.size(); ++begin) {
+        for (size_t end = input.size() + 1; end-- > begin; ) {
+            if (matches_span(pattern, input, begin, end)) {
+                return MatchSpan(begin, end);
+            }
+        }
+    }
+    return MatchSpan();
+}
+
+std::string describe(MatchSpan span) {
+    return span ? "[" + std::to_string(span.begin) + "," + std::to_string(span.end) + ")" : "none";
+}
+
+template <typename P>
+void check_find(const char *source, const std::string &alphabet, size_t max_length) {
+    std::regex pattern(source);
+    for_each_string(alphabet, max_length, [&](const std::string &input) {
+        MatchSpan expected = oracle(pattern, input, 0);
+        MatchSpan actual = P::find(input.data(), input.size());
+        if (describe(actual) != describe(expected)) {
+            fail(__FILE__, __LINE__, std::string(source) + " on \"" + input + "\": find gives " +
+                describe(actual) + ", expected " + describe(expected));
+        }
+    });
+}
+
+// The matches find_all should give: one leftmost-longest match after another,
+// and one byte further on after an empty one.
+std::string oracle_all(const std::regex &pattern, const std::string &input) {
+    std::string result;
+    for (size_t from = 0; from <= input.size(); ) {
+        MatchSpan span = oracle(pattern, input, from);
+        if (!span) {
+            break;
+        }
+        result += describe(span);
+        from = span.end == span.begin ? span.end + 1 : span.end;
+    }
+    return result;
+}
+
+template <typename P>
+void check_find_all(const char *source, const std::string &alphabet, size_t max_length) {
+    std::regex pattern(source);
+    for_each_string(alphabet, max_length, [&](const std::string &input) {
+        std::string actual;
+        for (std::string_view match : P::find_all(input)) {
+            size_t begin = match.data() - input.data();
+            actual += describe(MatchSpan(begin, begin + match.size()));
+        }
+        std::string expected = oracle_all(pattern, input);
+        if (actual != expected) {
+            fail(__FILE__, __LINE__, std::string(source) + " on \"" + input + "\": find_all gives " +
+                actual + ", expected " + expected);
+        }
+    });
+}
+
+#define CHECK_FIND(pattern, alphabet, max_length) check_find<REGEX(pattern)>(pattern, alphabet, max_length)
+#define CHECK_FIND_ALL(pattern, alphabet, max_length) check_find_all<REGEX(pattern)>(pattern, alphabet, max_length)
+
+}
+
+int main() {
+    using Overlap = Regex<Union<Concat<Char<'a'>, Char<'b'>, Char<'c'>, Char<'d'>>, Char<'c'>>>;
+    MatchSpan span = Overlap::find("abcdc");
+    CHECK_EQ(span.begin, 0u);
+    CHECK_EQ(span.end, 4u);
+    span = Overlap::find("daabcd");
+    CHECK_EQ(span.begin, 2u);
+    CHECK_EQ(span.end, 6u);
+
+    // A long chain before a loop. Minimizing its automata must fit in the
+    // compiler's default limits.
+    using Chain = REGEX("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWX(0|12)*");
+    span = Chain::find("xxabcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWX0120yy");
+    CHECK_EQ(span.begin, 2u);
+    CHECK_EQ(span.end, 56u);
+
+    std::string words;
+    for (std::string_view match : Overlap::find_all("abcdcxabcabcd")) {
+        words += std::string(match) + " ";
+    }
+    CHECK(words == "abcd c c abcd ");
+
+    CHECK_FIND("abcd|c", "abcd", 7);
+    CHECK_FIND("ab|b|bcd", "abcd", 7);
+    CHECK_FIND("a(b|c)*d|b|cd", "abcd", 7);
+    CHECK_FIND("a+b|a", "ab", 9);
+    CHECK_FIND("(ab)*", "ab", 8);
+    CHECK_FIND("b*", "ab", 8);
+    CHECK_FIND("a[ab]{2}|b", "ab", 9);
+    CHECK_FIND("^ab|b", "ab", 8);
+    CHECK_FIND("ab$|b|aba", "ab", 8);
+    CHECK_FIND("c(a|b)*c|a", "abc", 6);
+
+    CHECK_FIND_ALL("abcd|c", "abcd", 7);
+    CHECK_FIND_ALL("ab|b|bcd", "abcd", 7);
+    CHECK_FIND_ALL("a|ab|abc", "abc", 7);
+    CHECK_FIND_ALL("a+b|a", "ab", 9);
+    CHECK_FIND_ALL("b*", "ab", 8);
+    CHECK_FIND_ALL("^a|ab|b$", "ab", 8);
+    return report("find");
+}
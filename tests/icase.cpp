@@ -0,0 +1,71 @@
+// ICase against std::regex with icase, on every string over an alphabet of
+// letters in both cases, digits and bytes above 127. It is taken of the AST and
+// of a Regex type, which must give the same automaton. Bytes above 127 keep
+// their case: ICase only folds ASCII letters.
+#include <regex>
+#include <string>
+#include "regex.hpp"
+#include "parser.hpp"
+#include "check.hpp"
+
+namespace {
+
+// match reads BeginSymbol and EndSymbol around the input, as < and > here, see
+// tests/engines.cpp.
+std::string symbols(const char *source) {
+    std::string result;
+    for (const char *c = source; *c; ++c) {
+        if (*c == '^' && c != source && c[-1] == '[') {
+            result += "^<>";
+        } else if (*c == '^' || *c == '$') {
+            result += *c == '^' ? '<' : '>';
+        } else {
+            result += *c;
+        }
+    }
+    return result;
+}
+
+template <typename P>
+void check_icase(const char *source, const std::string &alphabet, size_t max_length) {
+    using OfAST = Regex<ICase<typename PatternOf<P>::Type>>;
+    using OfRegex = ICase<P>;
+    static_assert(std::is_same<OfRegex, OfAST>::value, "");
+    std::regex pattern(source, std::regex::ECMAScript | std::regex::icase);
+    std::regex whole(symbols(source), std::regex::ECMAScript | std::regex::icase);
+    for_each_string(alphabet, max_length, [&](const std::string &input) {
+        bool match = std::regex_match("<" + input + ">", whole);
+        bool search = std::regex_search(input, pattern);
+        if (OfRegex::match(input) != match || OfRegex::search(input) != search) {
+            fail(__FILE__, __LINE__, std::string("ICase ") + source + " on \"" + input + "\": match gives " +
+                std::to_string(OfRegex::match(input)) + ", search " + std::to_string(OfRegex::search(input)) +
+                ", expected " + std::to_string(match) + ", " + std::to_string(search));
+        }
+    });
+}
+
+#define CHECK_ICASE(pattern, alphabet, max_length) \
+    check_icase<REGEX(pattern)>(pattern, alphabet, max_length)
+
+}
+
+int main() {
+    CHECK_ICASE("^(ab|c)+$", "aAbBcC", 5);
+    CHECK_ICASE("^[x-z]+a$", "xXyYzZaA", 4);
+    CHECK_ICASE("^a[^b]c$", "aAbBcC0", 3);
+    CHECK_ICASE("B[^a-c]|^Q", "aAbBcCqQ1", 4);
+    CHECK_ICASE("^[A-Cx]*1$", "aAcCdxX1", 4);
+    CHECK_ICASE("\x80[a\xe0]", "aA\x80\xe0\xc0", 3);
+
+    // The cases the folding must get right, spelled out.
+    using NotB = ICase<REGEX("^[^b]$")>;
+    CHECK(!NotB::match("b"));
+    CHECK(!NotB::match("B"));
+    CHECK(NotB::match("c"));
+    using Letters = ICase<REGEX("^[x-z]$")>;
+    CHECK(Letters::match("X") && Letters::match("y") && Letters::match("Z"));
+    CHECK(!Letters::match("w") && !Letters::match("W"));
+    static_assert(ICase<REGEX("^(get|post) /$")>::match("GeT /"), "");
+    static_assert(Regex<ICase<Concat<Begin, Char<'a'>, End>>>::match("A"), "");
+    return report("icase");
+}
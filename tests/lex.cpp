@@ -0,0 +1,195 @@
+// Lexer::lex against a brute-force tokenizer: at each position the longest
+// match_prefix of any pattern is the token, the first pattern listed wins a
+// tie, tokens of void patterns are dropped, and lexing stops where no pattern
+// matches a non-empty prefix. The same tokens must come out of lex resumed
+// with a small buffer, and out of Lexer::tokens.
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "lex.hpp"
+#include "check.hpp"
+
+namespace {
+
+struct Expected {
+    std::vector<Token> tokens;
+    size_t stop = 0;
+};
+
+// Void[i] says whether the i-th pattern is skipped.
+template <typename... R>
+Expected oracle(std::string_view input, const bool (&Void)[sizeof...(R)]) {
+    Expected result;
+    size_t pos = 0;
+    while (pos < input.size()) {
+        size_t length = 0;
+        size_t pattern = 0;
+        size_t i = 0;
+        auto longest = [&](size_t prefix) {
+            if (prefix != std::string_view::npos && prefix > length) {
+                length = prefix;
+                pattern = i;
+            }
+            ++i;
+        };
+        (longest(R::match_prefix(input.data() + pos, input.size() - pos)), ...);
+        if (length == 0) {
+            break;
+        }
+        if (!Void[pattern]) {
+            result.tokens.emplace_back(pattern, input.substr(pos, length));
+        }
+        pos += length;
+    }
+    result.stop = pos;
+    return result;
+}
+
+std::string describe(const std::vector<Token> &tokens) {
+    std::string result;
+    for (const Token &token : tokens) {
+        result += " " + std::to_string(token.type) + ":\"" + std::string(token.text) + "\"";
+    }
+    return "{" + result + " }";
+}
+
+bool same(const std::vector<Token> &a, const std::vector<Token> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].type != b[i].type || a[i].text.data() != b[i].text.data() || a[i].text.size() != b[i].text.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename L, typename... R>
+void check_lexer(const char *name, const bool (&Void)[sizeof...(R)], const std::string &alphabet, size_t max_length) {
+    for_each_string(alphabet, max_length, [&](const std::string &input) {
+        Expected expected = oracle<R...>(input, Void);
+        auto compare = [&](const std::string &how, const std::vector<Token> &tokens, size_t pos) {
+            if (!same(tokens, expected.tokens) || pos != expected.stop) {
+                fail(__FILE__, __LINE__, std::string(name) + " on \"" + input + "\": " + how + " gives " +
+                    describe(tokens) + " stopping at " + std::to_string(pos) + ", expected " +
+                    describe(expected.tokens) + " stopping at " + std::to_string(expected.stop));
+            }
+        };
+        std::vector<Token> tokens(input.size() + 1);
+        size_t pos = 0;
+        tokens.resize(L::lex(input, pos, tokens.data(), tokens.size()));
+        compare("lex", tokens, pos);
+
+        // Called again until it writes nothing, lex picks up where it left off.
+        for (size_t capacity = 1; capacity <= 3; ++capacity) {
+            tokens.clear();
+            pos = 0;
+            Token buffer[3];
+            while (size_t size = L::lex(input, pos, buffer, capacity)) {
+                tokens.insert(tokens.end(), buffer, buffer + size);
+            }
+            compare("lex into " + std::to_string(capacity), tokens, pos);
+        }
+
+        // position() is the end of the current token, and where lexing stopped
+        // once the iterator reaches the end.
+        tokens.clear();
+        auto range = L::tokens(input);
+        auto it = range.begin();
+        for (; it != range.end(); ++it) {
+            tokens.push_back(*it);
+            CHECK_EQ(it.position(), static_cast<size_t>(it->text.data() + it->text.size() - input.data()));
+        }
+        compare("tokens", tokens, it.position());
+    });
+}
+
+using Int = SimpleTokenGetter<int>;
+
+// "ab" against "abc", a+ against [a-c]+ on ties, a void pattern, and one that
+// only matches at some positions.
+using Keyword = REGEX("ab|abc");
+using As = REGEX("a+");
+using Letters = REGEX("[a-c]+");
+using Spaces = REGEX(" +");
+using Bs = REGEX("b*");
+using Mixed = Lexer<std::tuple<
+    std::pair<Keyword, Int>, std::pair<As, Int>, std::pair<Spaces, void>, std::pair<Letters, Int>, std::pair<Bs, Int>
+>>;
+
+// Only matches the empty string, which is never a token.
+using Nothing = Lexer<std::tuple<std::pair<Regex<Empty>, Int>, std::pair<REGEX("a"), Int>>>;
+
+}
+
+int main() {
+    check_lexer<Mixed, Keyword, As, Spaces, Letters, Bs>("Mixed", {false, false, true, false, false}, "abcd ", 6);
+
+    // Maximal munch: the longer match wins even if a later pattern gives it.
+    using Words = Lexer<std::tuple<std::pair<REGEX("if"), Int>, std::pair<REGEX("[a-z]+"), Int>, std::pair<REGEX(" +"), void>>>;
+    Token tokens[4];
+    size_t pos = 0;
+    CHECK_EQ(Words::lex("iffy if", pos, tokens, 4), 2u);
+    CHECK_EQ(pos, 7u);
+    CHECK_EQ(tokens[0].type, 1);
+    CHECK(tokens[0].text == "iffy");
+    // On a tie the first listed pattern wins.
+    CHECK_EQ(tokens[1].type, 0);
+    CHECK(tokens[1].text == "if");
+
+    // Void tokens are read but not written, and do not count against capacity.
+    pos = 0;
+    CHECK_EQ(Words::lex("  a  b  ", pos, tokens, 4), 2u);
+    CHECK_EQ(pos, 8u);
+    CHECK(tokens[0].text == "a" && tokens[1].text == "b");
+
+    // A pattern that matches the empty string gives no token there: lexing
+    // stops rather than loop in place.
+    pos = 0;
+    CHECK_EQ(Nothing::lex("aab", pos, tokens, 4), 2u);
+    CHECK_EQ(pos, 2u);
+    CHECK_EQ(Nothing::lex("aab", pos, tokens, 4), 0u);
+    CHECK_EQ(pos, 2u);
+
+    // A full buffer leaves pos after the last token written, before the void
+    // token that follows it; the next call skips that and writes nothing.
+    pos = 0;
+    CHECK_EQ(Words::lex("a b  ", pos, tokens, 2), 2u);
+    CHECK_EQ(pos, 3u);
+    CHECK_EQ(Words::lex("a b  ", pos, tokens, 2), 0u);
+    CHECK_EQ(pos, 5u);
+
+    // Lexing stops where no pattern matches, short of the end.
+    pos = 0;
+    CHECK_EQ(Words::lex("ab 7 cd", pos, tokens, 4), 1u);
+    CHECK_EQ(pos, 3u);
+
+    // Iterators are equal at the same place in the same buffer, and every
+    // ended iterator equals end(), whether the input ran out, with a void token
+    // last, or lexing stopped.
+    std::string_view text = "if x ";
+    auto range = Words::tokens(text);
+    CHECK(range.begin() == range.begin());
+    CHECK(range.begin() != range.end());
+    std::string copy(text);
+    CHECK(Words::tokens(copy).begin() != range.begin());
+    auto it = range.begin();
+    CHECK(it->text == "if");
+    CHECK_EQ(it.position(), 2u);
+    ++it;
+    CHECK(it->text == "x");
+    CHECK_EQ(it.position(), 4u);
+    CHECK(it != range.begin());
+    ++it;
+    CHECK(it == range.end());
+    CHECK_EQ(it.position(), 5u);
+    auto stopped = Words::tokens("if 7").begin();
+    ++stopped;
+    CHECK(stopped == Words::tokens("").end());
+    CHECK_EQ(stopped.position(), 3u);
+    CHECK(Words::tokens("").begin() == Words::tokens("").end());
+    CHECK(Words::tokens("   ").begin() == Words::tokens("").end());
+    return report("lex");
+}
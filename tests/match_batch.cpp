@@ -0,0 +1,87 @@
+// Regex::match_batch against one match per input, over batches of every size
+// around the lane count and inputs on both sides of the short-input cutoff,
+// and its handling of empty batches and of ranges of different sizes.
+#include <array>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "regex.hpp"
+#include "check.hpp"
+
+namespace {
+
+using Decimal = Regex<Concat<
+    Begin,
+    Option<CharClass<'+', '-'>>,
+    Plus<Digit>,
+    Option<Concat<Char<'.'>, Star<Digit>>>,
+    End
+>>;
+
+// Mostly decimals, some of them broken, of up to four times the short-input
+// cutoff.
+std::vector<std::string> generate(size_t count, std::mt19937 &random) {
+    std::vector<std::string> result(count);
+    for (std::string &input : result) {
+        size_t length = random() % (4 * Decimal::BatchMinLength + 1);
+        for (size_t i = 0; i < length; ++i) {
+            input += static_cast<char>('0' + random() % 10);
+        }
+        if (length > 2 && random() % 2 == 0) {
+            input[random() % length] = "+-.x"[random() % 4];
+        }
+    }
+    return result;
+}
+
+}
+
+int main() {
+    std::mt19937 random(7);
+    for (size_t count = 0; count <= 3 * Decimal::BatchLanes + 1; ++count) {
+        for (int round = 0; round < 50; ++round) {
+            std::vector<std::string> strings = generate(count, random);
+            std::vector<std::string_view> inputs(strings.begin(), strings.end());
+            std::vector<char> out(count, 2);
+            CHECK_EQ(Decimal::match_batch(inputs, out), count);
+            for (size_t i = 0; i < count; ++i) {
+                if (out[i] != Decimal::match(inputs[i].data(), inputs[i].size())) {
+                    fail(__FILE__, __LINE__, "batch of " + std::to_string(count) + ": \"" + strings[i] + "\"");
+                }
+            }
+        }
+    }
+
+    std::vector<std::string> strings = generate(20, random);
+    std::vector<std::string_view> inputs(strings.begin(), strings.end());
+
+    // Empty batches write nothing.
+    std::vector<std::string_view> none;
+    std::vector<char> out(4, 2);
+    CHECK_EQ(Decimal::match_batch(none, out), 0u);
+    CHECK(out == std::vector<char>(4, 2));
+    std::vector<char> empty;
+    CHECK_EQ(Decimal::match_batch(inputs, empty), 0u);
+
+    // A shorter out takes the first inputs only, a longer one keeps its tail.
+    std::array<bool, 12> few;
+    CHECK_EQ(Decimal::match_batch(inputs, few), 12u);
+    for (size_t i = 0; i < few.size(); ++i) {
+        CHECK(few[i] == Decimal::match(inputs[i].data(), inputs[i].size()));
+    }
+    std::vector<char> many(30, 2);
+    CHECK_EQ(Decimal::match_batch(inputs, many), 20u);
+    for (size_t i = 0; i < many.size(); ++i) {
+        CHECK(i < 20 ? many[i] == Decimal::match(inputs[i].data(), inputs[i].size()) : many[i] == 2);
+    }
+
+    // Arrays work too, and so does the pointer form.
+    std::string_view literals[] = {"12", "-3.5", "x", "123456789012345678901234567890"};
+    bool results[4] = {};
+    CHECK_EQ(Decimal::match_batch(literals, results), 4u);
+    CHECK(results[0] && results[1] && !results[2] && results[3]);
+    Decimal::match_batch_n(literals, 2, results + 2);
+    CHECK(results[2] && results[3]);
+    return report("match_batch");
+}
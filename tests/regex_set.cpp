@@ -0,0 +1,51 @@
+// RegexSet against the Regex of each of its patterns: bit i of match and
+// search must be what the i-th Regex's match and search give, on every string
+// over a small alphabet. The overloads over unsigned char and std::byte must
+// give what the ones over char do.
+#include <cstddef>
+#include <string>
+#include "regex.hpp"
+#include "parser.hpp"
+#include "check.hpp"
+
+namespace {
+
+template <typename... R>
+void check_set(const char *const (&sources)[sizeof...(R)], const std::string &alphabet, size_t max_length) {
+    using Set = RegexSet<R...>;
+    for_each_string(alphabet, max_length, [&](const std::string &input) {
+        typename Set::Matches match = Set::match(input);
+        typename Set::Matches search = Set::search(input);
+        size_t i = 0;
+        auto compare = [&](const char *operation, bool actual, bool expected) {
+            if (actual != expected) {
+                fail(__FILE__, __LINE__, std::string(sources[i]) + " on \"" + input + "\": " + operation +
+                    " bit is " + (actual ? "set" : "clear") + ", Regex gives " + (expected ? "true" : "false"));
+            }
+        };
+        ((compare("match", match[i], R::match(input.data(), input.size())),
+          compare("search", search[i], R::search(input.data(), input.size())), ++i), ...);
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(input.data());
+        const std::byte *data = reinterpret_cast<const std::byte *>(input.data());
+        CHECK(Set::match(bytes, input.size()) == match);
+        CHECK(Set::search(bytes, input.size()) == search);
+        CHECK(Set::match(data, input.size()) == match);
+        CHECK(Set::search(data, input.size()) == search);
+    });
+}
+
+static_assert(RegexSet<REGEX("^[0-9]+$"), REGEX("^[a-z]+$")>::match("abc")[1], "");
+static_assert(!RegexSet<REGEX("^[0-9]+$"), REGEX("^[a-z]+$")>::match("abc")[0], "");
+static_assert(RegexSet<REGEX("b"), REGEX("^b")>::search("ab").count() == 1, "");
+
+}
+
+int main() {
+    check_set<REGEX("ab"), REGEX("^ab"), REGEX("ab$"), REGEX("^ab$"), REGEX("^(a|b)*$")>(
+        {"ab", "^ab", "ab$", "^ab$", "^(a|b)*$"}, "abc", 6);
+    check_set<REGEX("^a[^a]*$|b"), REGEX("c+"), REGEX("^$"), REGEX("(ab|ba)+$"), REGEX("^c|a$")>(
+        {"^a[^a]*$|b", "c+", "^$", "(ab|ba)+$", "^c|a$"}, "abc", 6);
+    check_set<REGEX("\xff\x80+"), REGEX("^\x80[^\xff]*$"), REGEX("\x7f$"), REGEX("^[\x80\xff]+$")>(
+        {"\\xff\\x80+", "^\\x80[^\\xff]*$", "\\x7f$", "^[\\x80\\xff]+$"}, "\x80\xff\x7f", 6);
+    return report("regex_set");
+}
@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+"""Builds and runs the tests.
+
+Every tests/*.cpp is a program of its own that exits with status 0 when all
+of its checks pass. Each one instantiates many automata, so building takes a
+while; pass names to run only some of them.
+
+    tests/run.py
+    tests/run.py find match_batch
+    tests/run.py --cxx clang++ --flags "-O1"
+
+Tests listed in VARIANTS are built and run once more with each of the extra
+flags given there, where the machine can run the code they produce.
+
+The run exits with status 1 if a test fails to build or fails a check.
+"""
+
+import argparse
+import glob
+import os
+import platform
+import shlex
+import subprocess
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# Teddy has a path per instruction set; building the whole test for one also
+# runs the scalar parts as the compiler vectorizes them for it.
+VARIANTS = {"teddy": ["-mssse3", "-mavx2"]}
+
+
+def cpu_has(flag):
+    """Whether an -m<feature> flag gives code this machine can run."""
+    if platform.machine().lower() not in ("x86_64", "amd64", "i386", "i686"):
+        return False
+    try:
+        with open("/proc/cpuinfo") as cpuinfo:
+            features = cpuinfo.read().split()
+    except OSError:
+        return False
+    return flag[len("-m"):] in features
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("tests", nargs="*", help="tests to run, by file name without .cpp (default all)")
+    parser.add_argument("--cxx", default=os.environ.get("CXX", "g++"), help="compiler command (default $CXX or g++)")
+    parser.add_argument("--flags", default="-O2", help="extra compiler flags (default -O2)")
+    args = parser.parse_args()
+
+    sources = sorted(glob.glob(os.path.join(ROOT, "tests", "*.cpp")))
+    if args.tests:
+        sources = [s for s in sources if os.path.splitext(os.path.basename(s))[0] in args.tests]
+    failed = []
+    with tempfile.TemporaryDirectory() as work:
+        builds = []
+        for source in sources:
+            name = os.path.splitext(os.path.basename(source))[0]
+            builds.append((name, source, []))
+            for flag in VARIANTS.get(name, []):
+                if cpu_has(flag):
+                    builds.append((name + " " + flag, source, [flag]))
+                else:
+                    print("skipping", name, flag, "which this machine cannot run", flush=True)
+        for name, source, extra in builds:
+            binary = os.path.join(work, name.replace(" ", ""))
+            command = shlex.split(args.cxx) + ["-std=c++17", "-Wall", "-Wextra", "-I" + ROOT]
+            command += shlex.split(args.flags) + extra + [source, "-o", binary]
+            print("building", name, flush=True)
+            if subprocess.run(command).returncode != 0:
+                failed.append(name)
+                continue
+            if subprocess.run([binary]).returncode != 0:
+                failed.append(name)
+    if failed:
+        print("failed:", ", ".join(failed))
+        return 1
+    print("all %d builds passed" % len(builds))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,47 @@
+// RuntimeRegex's parser: patterns it must reject with std::invalid_argument,
+// among them repeat bounds that are out of order or too large to expand, and
+// bounds at the limit that it must still compile.
+#include <stdexcept>
+#include <string>
+#include "runtime.hpp"
+#include "check.hpp"
+
+namespace {
+
+bool rejects(const char *pattern) {
+    try {
+        RuntimeRegex regex(pattern);
+    } catch (const std::invalid_argument &) {
+        return true;
+    }
+    return false;
+}
+
+}
+
+int main() {
+    CHECK(rejects("a{3,1}"));
+    CHECK(rejects("a{1,0}"));
+    CHECK(rejects("a{1001}"));
+    CHECK(rejects("a{0,1001}"));
+    CHECK(rejects("a{2147483648}"));
+    CHECK(rejects("a{99999999999999999999}"));
+    CHECK(rejects("a{"));
+    CHECK(rejects("a{,2}"));
+    CHECK(rejects("a{2"));
+    CHECK(rejects("a{2,x}"));
+    CHECK(rejects("(a"));
+    CHECK(rejects("a)"));
+    CHECK(rejects("*a"));
+    CHECK(rejects("\\p{Klingon}"));
+
+    CHECK(RuntimeRegex("^a{3,3}$").match("aaa"));
+    CHECK(RuntimeRegex("^a{0,1}b$").match("b"));
+    CHECK(!RuntimeRegex("^a{2,}$").match("a"));
+    CHECK(RuntimeRegex("^a{2,}$").match("aaaaa"));
+    RuntimeRegex thousand("^a{1000}$");
+    CHECK(thousand.match(std::string(1000, 'a')));
+    CHECK(!thousand.match(std::string(999, 'a')));
+    CHECK(!thousand.match(std::string(1001, 'a')));
+    return report("runtime");
+}
@@ -0,0 +1,160 @@
+// Regex::Stream against match and a brute-force oracle: every input is fed in
+// two chunks split at every offset, and byte by byte. finish() must give what
+// match gives on the whole input, and the callbacks must be called once with
+// the end of every match that begins where the first callback feed did or
+// later. ^ and $ only match at the ends of the whole stream. Some of the feeds
+// go through the overloads over unsigned char and std::byte.
+#include <cstddef>
+#include <regex>
+#include <string>
+#include <vector>
+#include "regex.hpp"
+#include "parser.hpp"
+#include "check.hpp"
+
+namespace {
+
+bool matches_span(const std::regex &pattern, const std::string &input, size_t begin, size_t end) {
+    auto flags = std::regex_constants::match_default;
+    if (begin != 0) {
+        flags |= std::regex_constants::match_not_bol;
+    }
+    if (end != input.size()) {
+        flags |= std::regex_constants::match_not_eol;
+    }
+    return std::regex_match(input.begin() + begin, input.begin() + end, pattern, flags);
+}
+
+// The ends of the matches that begin at from or later, in order.
+std::vector<size_t> oracle(const std::regex &pattern, const std::string &input, size_t from) {
+    std::vector<size_t> ends;
+    for (size_t end = from; end <= input.size(); ++end) {
+        for (size_t begin = from; begin <= end; ++begin) {
+            if (matches_span(pattern, input, begin, end)) {
+                ends.push_back(end);
+                break;
+            }
+        }
+    }
+    return ends;
+}
+
+std::string describe(const std::vector<size_t> &ends) {
+    std::string result = "{";
+    for (size_t end : ends) {
+        result += (result.size() > 1 ? "," : "") + std::to_string(end);
+    }
+    return result + "}";
+}
+
+template <typename P>
+class Checker {
+public:
+    explicit Checker(const char *source) : source_(source), pattern_(source) {}
+    void operator()(const std::string &input) const {
+        bool match = P::match(input.data(), input.size());
+        std::vector<size_t> all = oracle(pattern_, input, 0);
+        for (size_t split = 0; split <= input.size(); ++split) {
+            const std::string where = " split at " + std::to_string(split);
+            typename P::Stream plain;
+            plain.feed(input.data(), split);
+            plain.feed(input.data() + split, input.size() - split);
+            compare(input, "finish()" + where, plain.finish(), match);
+
+            std::vector<size_t> ends;
+            auto on_match = [&](size_t end) { ends.push_back(end); };
+            typename P::Stream searched;
+            searched.feed(input.data(), split, on_match);
+            searched.feed(input.data() + split, input.size() - split, on_match);
+            compare(input, "finish(on_match)" + where, searched.finish(on_match), match);
+            compare(input, "ends" + where, ends, all);
+
+            // The search starts with the first callback feed.
+            ends.clear();
+            const std::byte *data = reinterpret_cast<const std::byte *>(input.data());
+            typename P::Stream late;
+            late.feed(data, split);
+            late.feed(data + split, input.size() - split, on_match);
+            compare(input, "finish(on_match) after feed" + where, late.finish(on_match), match);
+            compare(input, "ends after feed" + where, ends, oracle(pattern_, input, split));
+        }
+        std::vector<size_t> ends;
+        auto on_match = [&](size_t end) { ends.push_back(end); };
+        typename P::Stream bytes;
+        for (unsigned char c : input) {
+            bytes.feed(&c, 1, on_match);
+        }
+        compare(input, "finish(on_match) byte by byte", bytes.finish(on_match), match);
+        compare(input, "ends byte by byte", ends, all);
+        CHECK_EQ(bytes.offset(), input.size());
+    }
+private:
+    template <typename T>
+    void compare(const std::string &input, const std::string &what, const T &actual, const T &expected) const {
+        if (actual != expected) {
+            fail(__FILE__, __LINE__, std::string(source_) + " on \"" + input + "\": " + what + " gives " +
+                describe(actual) + ", expected " + describe(expected));
+        }
+    }
+    static std::string describe(bool value) {
+        return value ? "true" : "false";
+    }
+    static std::string describe(const std::vector<size_t> &ends) {
+        return ::describe(ends);
+    }
+    const char *source_;
+    std::regex pattern_;
+};
+
+template <typename P>
+void check_stream(const char *source, const std::string &alphabet, size_t max_length) {
+    Checker<P> checker(source);
+    for_each_string(alphabet, max_length, checker);
+}
+
+#define CHECK_STREAM(pattern, alphabet, max_length) \
+    check_stream<REGEX(pattern)>(pattern, alphabet, max_length)
+
+}
+
+int main() {
+    CHECK_STREAM("ab|b", "ab", 7);
+    CHECK_STREAM("a*", "ab", 6);
+    CHECK_STREAM("^a(b|c)*", "abc", 5);
+    CHECK_STREAM("ab$|ba", "ab", 7);
+    CHECK_STREAM("^(ab)*$", "ab", 8);
+    CHECK_STREAM("^$|a[^a]", "abc", 5);
+    CHECK_STREAM("\xff\x80+", "\x80\xff\x7f", 6);
+    CHECK_STREAM("^\x80[^\xff]*$|\x7f\xff", "\x80\xff\x7f", 5);
+
+    // An empty match at the start is reported as soon as the search starts,
+    // before any byte is fed.
+    std::vector<size_t> ends;
+    auto on_match = [&](size_t end) { ends.push_back(end); };
+    REGEX("^b*")::Stream start;
+    start.feed("", 0, on_match);
+    CHECK(ends == std::vector<size_t>{0});
+
+    // A match that needs $ ends where the stream does, which only finish knows.
+    ends.clear();
+    REGEX("ab$")::Stream end;
+    end.feed("xab", 3, on_match);
+    CHECK(ends.empty());
+    CHECK(!end.finish(on_match));
+    CHECK(ends == std::vector<size_t>{3});
+
+    // Plain feeds move the match state only; the search starts with the first
+    // callback, so matches before it are not reported.
+    ends.clear();
+    REGEX("^a+b")::Stream late;
+    late.feed("aa", 2);
+    late.feed("ab", 2, on_match);
+    CHECK(ends.empty());
+    CHECK(!late.finish(on_match));
+    ends.clear();
+    REGEX("a+b")::Stream unanchored;
+    unanchored.feed("aa", 2);
+    unanchored.feed("ab", 2, on_match);
+    CHECK(ends == std::vector<size_t>{4});
+    return report("stream");
+}
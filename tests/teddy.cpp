@@ -0,0 +1,128 @@
+// teddy_find, and each of its vector paths the CPU has, against a brute-force
+// search for the leading literals of a pattern; then Regex::search and find,
+// whose candidates come from Teddy, against std::regex. Inputs are long and
+// random, so the vector loops run many blocks and leave a scalar tail.
+// tests/run.py also builds this file with -mssse3 and with -mavx2.
+#include <random>
+#include <regex>
+#include <string>
+#include "regex.hpp"
+#include "parser.hpp"
+#include "check.hpp"
+
+namespace {
+
+bool matches_span(const std::regex &pattern, const std::string &input, size_t begin, size_t end) {
+    auto flags = std::regex_constants::match_default;
+    if (begin != 0) {
+        flags |= std::regex_constants::match_not_bol;
+    }
+    if (end != input.size()) {
+        flags |= std::regex_constants::match_not_eol;
+    }
+    return std::regex_match(input.begin() + begin, input.begin() + end, pattern, flags);
+}
+
+// std::regex_search finds the leftmost begin; the longest end from there is
+// tried one by one.
+MatchSpan oracle(const std::regex &pattern, const std::string &input) {
+    std::smatch found;
+    if (!std::regex_search(input, found, pattern)) {
+        return MatchSpan();
+    }
+    size_t begin = found.position(0);
+    for (size_t end = input.size(); end > begin; --end) {
+        if (matches_span(pattern, input, begin, end)) {
+            return MatchSpan(begin, end);
+        }
+    }
+    return MatchSpan(begin, begin);
+}
+
+std::string describe(size_t position) {
+    return position == std::string_view::npos ? "npos" : std::to_string(position);
+}
+
+std::string describe(bool value) {
+    return value ? "true" : "false";
+}
+
+std::string describe(MatchSpan span) {
+    return span ? "[" + std::to_string(span.begin) + "," + std::to_string(span.end) + ")" : "none";
+}
+
+template <typename L>
+size_t brute_force(const std::string &input, size_t from) {
+    for (size_t i = from; i + L::Length <= input.size(); ++i) {
+        for (size_t k = 0; k < L::Count; ++k) {
+            if (std::equal(L::Strings[k].data(), L::Strings[k].data() + L::Length, input.begin() + i,
+                    [](unsigned char a, char b) { return a == static_cast<unsigned char>(b); })) {
+                return i;
+            }
+        }
+    }
+    return std::string_view::npos;
+}
+
+// Inputs of 64 to 320 bytes made of pieces and random bytes of alphabet.
+std::string random_input(std::mt19937 &random, const std::string &alphabet, const std::vector<std::string> &pieces) {
+    std::string input;
+    for (size_t length = 64 + random() % 257; input.size() < length; ) {
+        if (random() % 8 == 0) {
+            input += pieces[random() % pieces.size()];
+        } else {
+            input += alphabet[random() % alphabet.size()];
+        }
+    }
+    return input;
+}
+
+template <typename R>
+void check_teddy(const char *source, const std::string &alphabet, std::initializer_list<const char *> pieces) {
+    using DFA_ = CompileRegex<R>;
+    using Leading = LeadingLiterals<DFA_>;
+    static_assert(Leading::Count > 1, "the pattern is not searched for with Teddy");
+    constexpr auto &Masks = CandidateFinder<DFA_>::Masks;
+    std::regex pattern(source);
+    std::vector<std::string> choices(pieces.begin(), pieces.end());
+    std::mt19937 random(7);
+    for (int round = 0; round < 300; ++round) {
+        std::string input = random_input(random, alphabet, choices);
+        const char *str = input.data();
+        size_t length = input.size();
+        auto compare = [&](const char *operation, auto actual, auto expected) {
+            if (describe(actual) != describe(expected)) {
+                fail(__FILE__, __LINE__, std::string(source) + " on \"" + input + "\": " + operation + " gives " +
+                    describe(actual) + ", expected " + describe(expected));
+            }
+        };
+        for (size_t from : {size_t(0), size_t(1), size_t(random() % length), length}) {
+            size_t expected = brute_force<Leading>(input, from);
+            compare("teddy_find", teddy_find(Masks, str, length, from), expected);
+            compare("teddy_find_scalar", teddy_find_scalar(Masks, str, length, from), expected);
+#if defined(__x86_64__) || defined(__i386__)
+            if (__builtin_cpu_supports("ssse3")) {
+                compare("teddy_find_ssse3", teddy_find_ssse3(Masks, str, length, from), expected);
+            }
+            if (__builtin_cpu_supports("avx2")) {
+                compare("teddy_find_avx2", teddy_find_avx2(Masks, str, length, from), expected);
+            }
+#endif
+        }
+        MatchSpan expected = oracle(pattern, input);
+        compare("find", Regex<R>::find(str, length), expected);
+        compare("search", Regex<R>::search(str, length), static_cast<bool>(expected));
+    }
+}
+
+#define CHECK_TEDDY(pattern, alphabet, ...) \
+    check_teddy<PatternOf<REGEX(pattern)>::Type>(pattern, alphabet, {__VA_ARGS__})
+
+}
+
+int main() {
+    CHECK_TEDDY("foo|bar|baz", "abfoorz", "foo", "bar", "baz", "ba", "fo");
+    CHECK_TEDDY("(foo|bar)[0-9]+", "abfor0123", "foo1", "bar22", "bar", "fo0");
+    CHECK_TEDDY("ab[cd]|xyz|q[r-t]s", "abcdqrstxyz", "abd", "xyz", "qss", "xy", "qrr");
+    return report("teddy");
+}
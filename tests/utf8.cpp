@@ -0,0 +1,182 @@
+// UTF-8 classes at three levels. utf8_split must give sequences that match
+// exactly the encodings of the code points in a range: every such encoding is
+// matched, and the sequences match no more byte strings than there are code
+// points, so no surrogate, overlong or out-of-range form gets through. URange
+// must then accept and reject at the edges of each encoded length, and \p{...}
+// must agree between REGEX and RuntimeRegex, and with its table, on every code
+// point.
+#include <string>
+#include "regex.hpp"
+#include "parser.hpp"
+#include "runtime.hpp"
+#include "check.hpp"
+
+namespace {
+
+std::string encode(uint32_t c) {
+    ConstexprArray<unsigned char, 4> bytes;
+    utf8_encode(c, bytes);
+    return std::string(reinterpret_cast<const char *>(bytes.data()), utf8_length(c));
+}
+
+bool is_surrogate(uint32_t c) {
+    return c >= 0xD800 && c <= 0xDFFF;
+}
+
+bool matches(const Utf8Sequence &sequence, const std::string &bytes) {
+    if (sequence.Length != bytes.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        unsigned char c = bytes[i];
+        if (c < sequence.Low[i] || c > sequence.High[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <size_t N>
+bool matches(const Utf8Sequences<N> &sequences, const std::string &bytes) {
+    for (size_t i = 0; i < sequences.Size; ++i) {
+        if (matches(sequences.Items[i], bytes)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Forms that are not UTF-8 of any code point: surrogates, overlong encodings
+// and code points past 0x10FFFF.
+const std::string Invalid[] = {
+    "\xED\xA0\x80", "\xED\xBF\xBF", "\xC0\x80", "\xC1\xBF", "\xE0\x80\x80", "\xE0\x9F\xBF",
+    "\xF0\x80\x80\x80", "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xF7\xBF\xBF\xBF", "\x80", "\xBF", "\xFF",
+};
+
+void check_split(uint32_t from, uint32_t to) {
+    const std::string range = "[" + std::to_string(from) + ", " + std::to_string(to) + "]";
+    Utf8Sequences<MaxUtf8Sequences> sequences{};
+    utf8_split(sequences, {from, to});
+    uint64_t strings = 0;
+    for (size_t i = 0; i < sequences.Size; ++i) {
+        uint64_t count = 1;
+        for (size_t k = 0; k < sequences.Items[i].Length; ++k) {
+            count *= sequences.Items[i].High[k] - sequences.Items[i].Low[k] + 1;
+        }
+        strings += count;
+    }
+    uint64_t code_points = 0;
+    for (uint32_t c = 0; c <= MaxCodePoint; ++c) {
+        bool inside = c >= from && c <= to && !is_surrogate(c);
+        code_points += inside;
+        // Away from the range the count covers it.
+        if (c + 0x200 < from || c > to + 0x200) {
+            continue;
+        }
+        if (is_surrogate(c) || matches(sequences, encode(c)) == inside) {
+            continue;
+        }
+        fail(__FILE__, __LINE__, range + ": U+" + std::to_string(c) + (inside ? " is not matched" : " is matched"));
+    }
+    if (strings != code_points) {
+        fail(__FILE__, __LINE__, range + ": the sequences match " + std::to_string(strings) + " byte strings for " +
+            std::to_string(code_points) + " code points");
+    }
+    for (const std::string &bytes : Invalid) {
+        CHECK(!matches(sequences, bytes));
+    }
+}
+
+template <uint32_t From, uint32_t To>
+void check_urange() {
+    using Class = Regex<Concat<Begin, URange<From, To>, End>>;
+    const std::string range = "URange<" + std::to_string(From) + ", " + std::to_string(To) + ">";
+    for (uint32_t c : {From - 1, From, To, To + 1}) {
+        if (c > MaxCodePoint || is_surrogate(c)) {
+            continue;
+        }
+        std::string bytes = encode(c);
+        bool inside = c >= From && c <= To;
+        if (Class::match(bytes) != inside) {
+            fail(__FILE__, __LINE__, range + ": U+" + std::to_string(c) + (inside ? " is rejected" : " is accepted"));
+        }
+    }
+    for (const std::string &bytes : Invalid) {
+        CHECK(!Class::match(bytes));
+    }
+}
+
+// REGEX and RuntimeRegex of \p{Name} against the ranges in UnicodeProperties.
+template <typename R>
+void check_property(const char *source) {
+    const UnicodeProperty &property = UnicodeProperties[R::Index];
+    RuntimeRegex runtime(source);
+    for (uint32_t c = 0; c <= MaxCodePoint; ++c) {
+        if (is_surrogate(c)) {
+            continue;
+        }
+        bool inside = false;
+        for (size_t i = 0; i < property.Count; ++i) {
+            inside = inside || (c >= property.Ranges[i].From && c <= property.Ranges[i].To);
+        }
+        std::string bytes = encode(c);
+        if (R::Type::match(bytes) != inside || runtime.match(bytes) != inside) {
+            fail(__FILE__, __LINE__, std::string(source) + ": U+" + std::to_string(c) + " gives " +
+                std::to_string(R::Type::match(bytes)) + " at compile time and " +
+                std::to_string(runtime.match(bytes)) + " at run time, expected " + std::to_string(inside));
+        }
+    }
+    for (const std::string &bytes : Invalid) {
+        CHECK(!R::Type::match(bytes));
+        CHECK(!runtime.match(bytes));
+    }
+}
+
+template <typename T, size_t I>
+struct Property {
+    using Type = T;
+    static constexpr size_t Index = I;
+};
+
+#define CHECK_PROPERTY(name) \
+    check_property<Property<REGEX("^\\p{" name "}$"), unicode_property(name)>>("^\\p{" name "}$")
+
+}
+
+int main() {
+    check_split(0x7F, 0x80);
+    check_split(0x7FF, 0x800);
+    check_split(0xFFFF, 0x10000);
+    check_split(0x10FFFF, 0x10FFFF);
+    check_split(0xD7FF, 0xE000);
+    check_split(0xD800, 0xDFFF);
+    check_split(0x80, 0x7FF);
+    check_split(0x800, 0xFFFF);
+    check_split(0x10000, 0x10FFFF);
+    check_split(0x3F, 0x10041);
+    check_split(0x7C0, 0x1083F);
+    check_split(0, MaxCodePoint);
+
+    check_urange<0x7F, 0x80>();
+    check_urange<0x7FF, 0x800>();
+    check_urange<0xFFFF, 0x10000>();
+    check_urange<0x10FFFF, 0x10FFFF>();
+    check_urange<0xD7FF, 0xE000>();
+    check_urange<0, MaxCodePoint>();
+
+    CHECK_PROPERTY("Any");
+    CHECK_PROPERTY("ASCII");
+    CHECK_PROPERTY("Latin");
+    CHECK_PROPERTY("Greek");
+    CHECK_PROPERTY("Cyrillic");
+    CHECK_PROPERTY("Armenian");
+    CHECK_PROPERTY("Hebrew");
+    CHECK_PROPERTY("Arabic");
+    CHECK_PROPERTY("Devanagari");
+    CHECK_PROPERTY("Thai");
+    CHECK_PROPERTY("Hangul");
+    CHECK_PROPERTY("Hiragana");
+    CHECK_PROPERTY("Katakana");
+    CHECK_PROPERTY("Han");
+    return report("utf8");
+}
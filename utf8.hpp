@@ -0,0 +1,146 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "util.hpp"
+
+// Classes of code points over UTF-8 input, in the style of RE2 and of the
+// utf8-ranges crate. A range of code points is split into pieces whose
+// encodings have the same length and the same leading bytes, up to where the
+// trailing bytes run over all of 0x80 to 0xBF. Each piece is then a sequence of
+// byte ranges, and together they match the encodings of exactly the code
+// points in the range, so an automaton reads UTF-8 one byte at a time without
+// decoding it. Surrogates are not encoded in UTF-8 and are left out.
+struct CodePointRange {
+    uint32_t From;
+    uint32_t To;
+};
+
+constexpr uint32_t MaxCodePoint = 0x10FFFF;
+
+struct Utf8Sequence {
+    ConstexprArray<unsigned char, 4> Low;
+    ConstexprArray<unsigned char, 4> High;
+    size_t Length;
+};
+
+template <size_t N>
+struct Utf8Sequences {
+    ConstexprArray<Utf8Sequence, N> Items;
+    size_t Size;
+};
+
+constexpr size_t utf8_length(uint32_t c) {
+    return c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+}
+
+constexpr void utf8_encode(uint32_t c, ConstexprArray<unsigned char, 4> &Out) {
+    constexpr unsigned char Lead[] = {0, 0, 0xC0, 0xE0, 0xF0};
+    size_t Length = utf8_length(c);
+    for (size_t i = Length - 1; i > 0; --i) {
+        Out[i] = 0x80 | (c & 0x3F);
+        c >>= 6;
+    }
+    Out[0] = Lead[Length] | c;
+}
+
+// Appends the pieces of [From, To] to Result, in order of code points.
+template <size_t N>
+constexpr void utf8_split(Utf8Sequences<N> &Result, CodePointRange Range) {
+    ConstexprArray<CodePointRange, 16> Stack;
+    size_t Top = 0;
+    if (Range.To > MaxCodePoint) {
+        Range.To = MaxCodePoint;
+    }
+    if (Range.From <= Range.To) {
+        Stack[Top++] = Range;
+    }
+    while (Top > 0) {
+        CodePointRange R = Stack[--Top];
+        // The upper part is pushed first, so that the lower one comes first.
+        if (R.From <= 0xDFFF && R.To >= 0xD800) {
+            if (R.To > 0xDFFF) {
+                Stack[Top++] = {0xE000, R.To};
+            }
+            if (R.From < 0xD800) {
+                Stack[Top++] = {R.From, 0xD7FF};
+            }
+            continue;
+        }
+        if (utf8_length(R.From) != utf8_length(R.To)) {
+            uint32_t Last = R.From < 0x80 ? 0x7F : R.From < 0x800 ? 0x7FF : 0xFFFF;
+            Stack[Top++] = {Last + 1, R.To};
+            Stack[Top++] = {R.From, Last};
+            continue;
+        }
+        bool Split = false;
+        for (size_t i = 1; i < utf8_length(R.From) && !Split; ++i) {
+            uint32_t Trailing = (uint32_t(1) << (6 * i)) - 1;
+            if ((R.From & ~Trailing) == (R.To & ~Trailing)) {
+                continue;
+            }
+            if ((R.From & Trailing) != 0) {
+                Stack[Top++] = {(R.From | Trailing) + 1, R.To};
+                Stack[Top++] = {R.From, R.From | Trailing};
+                Split = true;
+            } else if ((R.To & Trailing) != Trailing) {
+                Stack[Top++] = {R.To & ~Trailing, R.To};
+                Stack[Top++] = {R.From, (R.To & ~Trailing) - 1};
+                Split = true;
+            }
+        }
+        if (Split) {
+            continue;
+        }
+        Utf8Sequence &Sequence = Result.Items[Result.Size++];
+        Sequence.Length = utf8_length(R.From);
+        utf8_encode(R.From, Sequence.Low);
+        utf8_encode(R.To, Sequence.High);
+    }
+}
+
+// One range takes a dozen pieces at most, so this holds the ranges of any of
+// the properties below.
+constexpr size_t MaxUtf8Sequences = 96;
+
+constexpr Utf8Sequences<MaxUtf8Sequences> utf8_sequences(const CodePointRange *Ranges, size_t Count) {
+    Utf8Sequences<MaxUtf8Sequences> Result{};
+    for (size_t i = 0; i < Count; ++i) {
+        utf8_split(Result, Ranges[i]);
+    }
+    return Result;
+}
+
+// Named classes for \p{...}. They are approximated by the Unicode blocks of
+// each script rather than taken from the Scripts table.
+struct UnicodeProperty {
+    std::string_view Name;
+    CodePointRange Ranges[6];
+    size_t Count;
+};
+
+constexpr UnicodeProperty UnicodeProperties[] = {
+    {"Any", {{0, MaxCodePoint}}, 1},
+    {"ASCII", {{0, 0x7F}}, 1},
+    {"Latin", {{0x41, 0x5A}, {0x61, 0x7A}, {0xC0, 0xD6}, {0xD8, 0xF6}, {0xF8, 0x24F}, {0x1E00, 0x1EFF}}, 6},
+    {"Greek", {{0x370, 0x3FF}, {0x1F00, 0x1FFF}}, 2},
+    {"Cyrillic", {{0x400, 0x52F}}, 1},
+    {"Armenian", {{0x530, 0x58F}}, 1},
+    {"Hebrew", {{0x590, 0x5FF}}, 1},
+    {"Arabic", {{0x600, 0x6FF}, {0x750, 0x77F}}, 2},
+    {"Devanagari", {{0x900, 0x97F}}, 1},
+    {"Thai", {{0xE00, 0xE7F}}, 1},
+    {"Hangul", {{0x1100, 0x11FF}, {0x3130, 0x318F}, {0xAC00, 0xD7AF}}, 3},
+    {"Hiragana", {{0x3040, 0x309F}}, 1},
+    {"Katakana", {{0x30A0, 0x30FF}, {0x31F0, 0x31FF}}, 2},
+    {"Han", {{0x2E80, 0x2FDF}, {0x3400, 0x4DBF}, {0x4E00, 0x9FFF}, {0xF900, 0xFAFF}, {0x20000, 0x2FA1F}}, 5},
+};
+
+constexpr size_t UnicodePropertiesCount = sizeof(UnicodeProperties) / sizeof(UnicodeProperties[0]);
+
+// Returns the index of the property called Name, or UnicodePropertiesCount.
+constexpr size_t unicode_property(std::string_view Name) {
+    size_t i = 0;
+    for (; i < UnicodePropertiesCount && UnicodeProperties[i].Name != Name; ++i);
+    return i;
+}
@@ -192,13 +192,13 @@ struct SetImpl;
 
 template <template <typename...> class L, typename... Args, ssize_t Index, typename T, size_t... I>
 struct SetImpl<L<Args...>, Index, T, std::index_sequence<I...>> {
-    template <ssize_t J>
+    template <ssize_t J, bool = J == Index>
     struct Getter {
         using Type = Get<L<Args...>, J>;
     };
 
-    template <>
-    struct Getter<Index> {
+    template <ssize_t J>
+    struct Getter<J, true> {
         using Type = T;
     };
 